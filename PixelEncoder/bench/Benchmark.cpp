@@ -0,0 +1,187 @@
+// Pixel Encoder Benchmark
+// Runs every phase of the encoder on a synthetic or given
+// input file and writes the instrumentation report as JSON.
+
+#include "Generator.h"
+#include "Analytics.h"
+#include "Encoder.h"
+#include "Decoder.h"
+#include "Instrument.h"
+#include "Reader.h"
+#include "Verifier.h"
+
+int main(int argc, char* argv[]) {
+    GeneratorConfig config;
+    std::string input;
+    std::string outDir = "bench_output/";
+    std::string jsonFile;
+    int threads = 1;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            badArgs = true;
+            break;
+        }
+        std::string value = argv[++i];
+        if (arg == "--feds")
+            config.feds = std::atoi(value.c_str());
+        else if (arg == "--events")
+            config.events = std::atoi(value.c_str());
+        else if (arg == "--occupancy")
+            config.occupancy = std::atof(value.c_str());
+        else if (arg == "--hot-fraction")
+            config.hotFraction = std::atof(value.c_str());
+        else if (arg == "--hot-factor")
+            config.hotFactor = std::atof(value.c_str());
+        else if (arg == "--zero-fraction")
+            config.zeroFraction = std::atof(value.c_str());
+        else if ((arg == "--layer-maps") && ((value == "same") || (value == "per-fed")))
+            config.perFEDLayers = (value == "per-fed");
+        else if (arg == "--seed")
+            config.seed = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--threads")
+            threads = std::atoi(value.c_str());
+        else if (arg == "--input")
+            input = value;
+        else if (arg == "--output")
+            outDir = value;
+        else if (arg == "--json")
+            jsonFile = value;
+        else
+            badArgs = true;
+    }
+    if (badArgs || (threads < 1) || (config.feds < 1) || (config.events < 1)) {
+        std::cout << "usage: " << argv[0] << " [--input FILE | --feds N --events N\n"
+                  << "       --occupancy X --hot-fraction X --hot-factor X\n"
+                  << "       --zero-fraction X --layer-maps same|per-fed --seed N]\n"
+                  << "       [--threads N]\n"
+                  << "       [--output DIR] [--json FILE]\n";
+        return 1;
+    }
+    if (outDir.back() != '/')
+        outDir += '/';
+    std::filesystem::create_directories(outDir);
+
+    // program output of the phases is not part of the report
+    std::ostringstream log;
+    std::streambuf* coutBuffer = std::cout.rdbuf(log.rdbuf());
+
+    bool generated = input.empty();
+    if (generated) {
+        input = outDir + "bench_input.root";
+        long long entries;
+        {
+            ScopedTimer timer("generate");
+            Generator generator(config);
+            entries = generator.write(input);
+            if (entries >= 0)
+                timer.add(entries, std::filesystem::file_size(input));
+        }
+        if (entries < 0) {
+            std::cout.rdbuf(coutBuffer);
+            std::cerr << "Couldn't write " << input << "\n";
+            return 1;
+        }
+        Instrument::stat("generator_feds", config.feds);
+        Instrument::stat("generator_events", config.events);
+        Instrument::stat("generator_seed", config.seed);
+        Instrument::info("generator_layer_maps", config.perFEDLayers ? "per-fed" : "same");
+        Instrument::info("generator_occupancy", std::to_string(config.occupancy));
+        Instrument::info("generator_hot_fraction", std::to_string(config.hotFraction));
+        Instrument::info("generator_hot_factor", std::to_string(config.hotFactor));
+        Instrument::info("generator_zero_fraction", std::to_string(config.zeroFraction));
+    }
+    Instrument::info("input", input);
+    Instrument::stat("threads", threads);
+
+    Encoder encoder(threads);
+    Reader reader(input, threads);
+    if (reader.read(encoder) != 1) {
+        std::cout.rdbuf(coutBuffer);
+        std::cerr << "Couldn't read " << input << "\n";
+        return 1;
+    }
+    encoder.process();
+    int fed = encoder.haFEDID;
+    Instrument::stat("hits", encoder.totalHits);
+    Instrument::stat("events", encoder.totalEvents);
+    Instrument::stat("feds", encoder.totalFEDs);
+    Instrument::stat("target_fed", fed);
+
+    Analytics analytics(encoder);
+    analytics.run(threads);
+    analytics.write(outDir);
+    // a generated input gives the layer of every channel of every fed,
+    // the analytics must report each fed's own map
+    int layerErrors = 0;
+    if (generated) {
+        Generator generator(config);
+        for (auto const& summary : analytics.feds()) {
+            for (int ch = 1; ch < 49; ch++) {
+                if ((summary.channels[ch].max > 0) &&
+                    (summary.layers[ch] != generator.layer(summary.fed, ch)))
+                    layerErrors++;
+            }
+        }
+    }
+
+    Images images;
+    encoder.build(fed, images);
+    for (size_t i = 0; i < images.hit.size(); i++) {
+        std::string n = std::to_string(i) + ".bin";
+        Encoder::writeImage(outDir + "SRAMhit" + n, images.hit[i]);
+        Encoder::writeImage(outDir + "SRAMpix" + n, images.pix[i]);
+    }
+    // the block types of a generated input follow from the generator's
+    // layers of the target fed, 64-bit if a layer 3-5 roc has over 15 hits
+    int headerErrors = 0;
+    if (generated) {
+        Generator generator(config);
+        bool wide = false;
+        auto hits = encoder.storage.fed(fed);
+        for (const Hit* p = hits.first; p != hits.second;) {
+            const Hit* r = p;
+            while ((r != hits.second) && (r->event == p->event) && (r->ch == p->ch) && (r->roc == p->roc))
+                r++;
+            if ((p->roc > 0) && (r - p > 15) && (generator.layer(fed, p->ch) > 2))
+                wide = true;
+            p = r;
+        }
+        FEDStats stats = encoder.fedStats(fed);
+        const Format& format = encoder.format();
+        for (size_t file = 0; file < images.hit.size(); file++) {
+            uint32_t header;
+            std::memcpy(&header, images.hit[file].data(), Format::HEADERBYTES);
+            for (int block = 0; block < format.channels; block++) {
+                int ch = file * format.channels + block + 1;
+                int layer = generator.layer(fed, ch);
+                uint32_t expected = !stats.used[ch] ? 0 : ((layer == 1) ? 0 : ((layer == 2) ? 1 : (wide ? 3 : 2)));
+                if (((header >> format.headerShift(block)) & 3) != expected)
+                    headerErrors++;
+            }
+        }
+    }
+    encoder.graph(fed, outDir);
+
+    Decoder decoder(fed, encoder.fedStats(fed).histogramBins(), encoder.format());
+    decoder.decode(outDir, threads);
+    Verifier verifier(encoder, fed, outDir);
+    int mismatches = verifier.verify(std::cout, &decoder);
+
+    std::cout.rdbuf(coutBuffer);
+    if (mismatches != 0)
+        std::cerr << "Warning: verification reported " << mismatches << " mismatches.\n";
+    if (headerErrors != 0)
+        std::cerr << "Warning: " << headerErrors << " SRAMhit blocks have the wrong type for their layer.\n";
+    if (layerErrors != 0)
+        std::cerr << "Warning: analytics reported the wrong layer for " << layerErrors << " channels.\n";
+
+    if (jsonFile.empty()) {
+        Instrument::writeJSON(std::cout);
+    } else {
+        std::ofstream json(jsonFile);
+        Instrument::writeJSON(json);
+    }
+    return ((mismatches == 0) && (headerErrors == 0) && (layerErrors == 0)) ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Synthetic Pixel Generator
+
+#include "Generator.h"
+
+#include <random>
+
+// one entry of either tree
+struct PixelData {
+    int _eventID;
+    int _fedID;
+    int _layer;
+    int _channel;
+    int _ROC;
+    int _row;
+    int _col;
+    int _adc;
+};
+
+static const char* LEAVES =
+    "_eventID/I:_fedID/I:_layer/I:_channel/I:_ROC/I:_row/I:_col/I:_adc/I";
+
+int Generator::layer(int fed, int ch) const {
+    if (config_.perFEDLayers)
+        ch = (ch - 1 + 8 * (fed % 6)) % 48 + 1;
+    if (ch <= 8)
+        return 1;
+    if (ch <= 16)
+        return 2;
+    if (ch <= 32)
+        return 3;
+    if (ch <= 40)
+        return 4;
+    return 5;
+}
+
+long long Generator::write(std::string filename) {
+    TFile file(filename.c_str(), "RECREATE");
+    if (!(file.IsOpen()))
+        return -1;
+    std::mt19937_64 random(config_.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> row(0, 79);
+    std::uniform_int_distribution<int> col(0, 51);
+    std::uniform_int_distribution<int> adc(0, 255);
+    std::poisson_distribution<int> normalHits(config_.occupancy);
+    std::poisson_distribution<int> hotHits(config_.occupancy * config_.hotFactor);
+
+    // hot rocs are picked once per fed, channel and roc
+    std::vector<bool> hot((size_t)config_.feds * 48 * 8);
+    for (size_t i = 0; i < hot.size(); i++)
+        hot[i] = (uniform(random) < config_.hotFraction);
+
+    PixelData data;
+    // trees belong to the file, which deletes them on Close()
+    TTree* hitTree = new TTree("HighFedData", "Pixel hits");
+    hitTree->Branch("Data", &data, LEAVES);
+    TTree* zeroTree = new TTree("ZeroData", "Events with zero hits");
+    zeroTree->Branch("Data", &data, LEAVES);
+
+    long long entries = 0;
+    for (int event = 1; event <= config_.events; event++) {
+        for (int fed = 1; fed <= config_.feds; fed++) {
+            data._eventID = event;
+            data._fedID = fed;
+            if (uniform(random) < config_.zeroFraction) {
+                data._layer = 0;
+                data._channel = data._ROC = data._row = data._col = data._adc = 0;
+                zeroTree->Fill();
+                continue;
+            }
+            for (int ch = 1; ch <= 48; ch++) {
+                data._layer = layer(fed, ch);
+                data._channel = ch;
+                int rocs = (data._layer == 1) ? 2 : ((data._layer == 2) ? 4 : 8);
+                for (int roc = 1; roc <= rocs; roc++) {
+                    size_t id = ((size_t)(fed - 1) * 48 + (ch - 1)) * 8 + (roc - 1);
+                    int hits = hot[id] ? hotHits(random) : normalHits(random);
+                    data._ROC = roc;
+                    for (int h = 0; h < hits; h++) {
+                        data._row = row(random);
+                        data._col = col(random);
+                        data._adc = adc(random);
+                        hitTree->Fill();
+                        entries++;
+                    }
+                }
+            }
+        }
+    }
+    file.Write();
+    file.Close();
+    return entries;
+}
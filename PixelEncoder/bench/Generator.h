@@ -0,0 +1,43 @@
+// Synthetic Pixel Generator
+// Writes HighFedData and ZeroData TTrees with random pixdigi
+// data in the input format of the encoder, for benchmarking.
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "Includes.h"
+
+struct GeneratorConfig {
+    int feds = 139;
+    int events = 1000;
+    // mean hits per roc per event
+    double occupancy = 0.2;
+    // fraction of rocs that are hot, and their occupancy multiplier
+    double hotFraction = 0.01;
+    double hotFactor = 20.0;
+    // fraction of fed events with zero hits
+    double zeroFraction = 0.01;
+    // feds map channels to layers in different orders
+    bool perFEDLayers = false;
+    unsigned seed = 1;
+};
+
+class Generator {
+ private:
+  GeneratorConfig config_;
+ public:
+  Generator(const GeneratorConfig& config) : config_(config) { }
+  virtual ~Generator() { }
+
+  // layer of a channel of a fed
+  //  1-8: layer 1, 9-16: layer 2, 17-32: layer 3,
+  //  33-40: layer 4, 41-48: FPix (5)
+  // with perFEDLayers the channels of fed f are first
+  // rotated by 8 * (f % 6)
+  int layer(int fed, int ch) const;
+  // writes the trees to filename
+  // returns the number of HighFedData entries, -1 on failure
+  long long write(std::string filename);
+};
+
+#endif
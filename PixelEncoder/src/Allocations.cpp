@@ -0,0 +1,28 @@
+// Allocation Counting
+// Replaces the global allocation functions to count heap
+// allocations for the run report. Kept apart from Instrument
+// so the library doesn't replace the allocator of the
+// program it is linked into.
+
+#include "Instrument.h"
+
+#include <new>
+
+// counting replacements of the global allocation functions,
+// the other forms of new and delete call these
+void* operator new(size_t size) {
+    Instrument::allocations.fetch_add(1, std::memory_order_relaxed);
+    Instrument::allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,322 @@
+// Occupancy Analytics
+//
+// Tables, one row per fed, channel or roc with hits:
+//  analytics_feds.csv      fed,events,hits,mean,p50,p90,p99,max,layer1,...,layer5
+//  analytics_channels.csv  fed,channel,layer,mean,p50,p90,p99,max
+//  analytics_rocs.csv      fed,channel,roc,layer,mean,p50,p90,p99,max
+//  analytics_events.csv    fed,rank,event,hits,channel,channel_hits,roc_channel,roc,roc_hits
+//  analytics_hits.csv      fed,hits,events,channels,rocs
+// the hits table counts the events, channels and rocs of a fed
+// with each number of hits per event, rows of zeros are left out.
+
+#include "Analytics.h"
+#include "Tasks.h"
+
+int parseTarget(std::string text, Target& target) {
+    if (text == "average") {
+        target.policy = TARGET_AVERAGE;
+    } else if (text == "peak") {
+        target.policy = TARGET_PEAK;
+    } else if (text == "p99") {
+        target.policy = TARGET_P99;
+    } else if (text.compare(0, 6, "layer:") == 0) {
+        target.policy = TARGET_LAYER;
+        target.layer = std::atoi(text.c_str() + 6);
+        if ((target.layer < 1) || (target.layer > 5))
+            return 0;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+std::string targetName(const Target& target) {
+    switch (target.policy) {
+        case TARGET_PEAK:
+        return "peak";
+        case TARGET_P99:
+        return "p99";
+        case TARGET_LAYER:
+        return "layer:" + std::to_string(target.layer);
+        default:
+        return "average";
+    }
+}
+
+// adds one event with hits to counts, index: hits
+static inline void count(std::vector<uint64_t>& counts, int hits) {
+    if ((size_t)hits >= counts.size())
+        counts.resize(hits + 1, 0);
+    counts[hits]++;
+}
+
+// adds counts into total, index: hits
+static void addCounts(std::vector<uint64_t>& total, const std::vector<uint64_t>& counts) {
+    if (total.size() < counts.size())
+        total.resize(counts.size(), 0);
+    for (size_t hits = 0; hits < counts.size(); hits++)
+        total[hits] += counts[hits];
+}
+
+// distribution of counts, index: hits
+static Occupancy occupancy(const std::vector<uint64_t>& counts) {
+    Occupancy result;
+    uint64_t total = 0;
+    double sum = 0.;
+    for (size_t hits = 0; hits < counts.size(); hits++) {
+        total += counts[hits];
+        sum += (double)hits * counts[hits];
+        if (counts[hits] != 0)
+            result.max = hits;
+    }
+    if (total == 0)
+        return result;
+    result.mean = sum / total;
+    // nearest rank: the smallest count with at least
+    // percent of the events at or below it
+    int* percentiles[3] = {&result.p50, &result.p90, &result.p99};
+    const uint64_t percents[3] = {50, 90, 99};
+    for (int p = 0; p < 3; p++) {
+        uint64_t rank = std::max((uint64_t)1, (percents[p] * total + 99) / 100);
+        uint64_t below = 0;
+        size_t hits = 0;
+        while ((below += counts[hits]) < rank)
+            hits++;
+        *percentiles[p] = hits;
+    }
+    return result;
+}
+
+FEDSummary Analytics::summarize(int fedID) const {
+    FEDSummary summary;
+    summary.fed = fedID;
+    // events with each number of hits in a channel or roc,
+    // events without hits in them are added at the end
+    std::vector<uint64_t> chanCounts[49];
+    std::vector<uint64_t> rocCounts[48 * 8];
+    // orders events by hits, then by event id. summary.worst is
+    // a heap with the kept event of the fewest hits on top
+    auto more = [](const EventSummary& a, const EventSummary& b) {
+        return (a.hits > b.hits) || ((a.hits == b.hits) && (a.event < b.event));
+    };
+    auto fed = encoder_.storage.fed(fedID);
+    forEachEvent(fed.first, fed.second, [&](int event, bool, const Hit* p, const Hit* end) {
+        summary.events++;
+        EventSummary worst;
+        worst.event = event;
+        while (p != end) {
+            int ch = p->ch;
+            int chHits = 0;
+            while ((p != end) && (p->ch == ch)) {
+                // count pixels in this roc
+                const Hit* r = p;
+                while ((r != end) && (r->ch == ch) && (r->roc == p->roc))
+                    r++;
+                int rocHits = r - p;
+                if (p->roc > 0) {
+                    chHits += rocHits;
+                    // layers are read from the fed's own hits,
+                    // feds may map a channel to different layers
+                    for (const Hit* h = p; h != r; h++) {
+                        if ((h->layer > 0) && (h->layer < 6))
+                            summary.layerHits[h->layer]++;
+                        if ((ch > 0) && (ch < 49))
+                            summary.layers[ch] = std::max(summary.layers[ch], (int)h->layer);
+                    }
+                    if ((ch > 0) && (ch < 49) && (p->roc < 9))
+                        count(rocCounts[(ch - 1) * 8 + p->roc - 1], rocHits);
+                    if (rocHits > worst.rocHits) {
+                        worst.rocHits = rocHits;
+                        worst.roc = p->roc;
+                        worst.rocChannel = ch;
+                    }
+                }
+                p = r;
+            }
+            if ((chHits > 0) && (ch > 0) && (ch < 49))
+                count(chanCounts[ch], chHits);
+            if (chHits > worst.channelHits) {
+                worst.channelHits = chHits;
+                worst.channel = ch;
+            }
+            worst.hits += chHits;
+        }
+        count(summary.eventHits, worst.hits);
+        summary.hits += worst.hits;
+        if ((summary.worst.size() < worstEvents_) || more(worst, summary.worst.front())) {
+            summary.worst.push_back(worst);
+            std::push_heap(summary.worst.begin(), summary.worst.end(), more);
+            if (summary.worst.size() > worstEvents_) {
+                std::pop_heap(summary.worst.begin(), summary.worst.end(), more);
+                summary.worst.pop_back();
+            }
+        }
+    });
+    std::sort_heap(summary.worst.begin(), summary.worst.end(), more);
+
+    summary.occupancy = occupancy(summary.eventHits);
+    for (int ch = 1; ch < 49; ch++) {
+        std::vector<uint64_t>& counts = chanCounts[ch];
+        if (counts.empty())
+            continue;
+        uint64_t withHits = 0;
+        for (uint64_t c : counts)
+            withHits += c;
+        counts[0] += summary.events - withHits;
+        summary.channels[ch] = occupancy(counts);
+        addCounts(summary.channelHits, counts);
+        for (int roc = 0; roc < 8; roc++) {
+            std::vector<uint64_t>& rocs = rocCounts[(ch - 1) * 8 + roc];
+            if (rocs.empty())
+                continue;
+            withHits = 0;
+            for (uint64_t c : rocs)
+                withHits += c;
+            rocs[0] += summary.events - withHits;
+            summary.rocs[(ch - 1) * 8 + roc] = occupancy(rocs);
+            addCounts(summary.rocHits, rocs);
+        }
+    }
+    return summary;
+}
+
+void Analytics::run(int threads) {
+    ScopedTimer timer("analytics");
+    std::vector<int> ids = encoder_.feds();
+    feds_.assign(ids.size(), FEDSummary());
+    runTasks(ids.size(), threads, [&](size_t f) {
+        feds_[f] = summarize(ids[f]);
+    });
+    for (auto const& summary : feds_)
+        timer.add(summary.hits);
+}
+
+int Analytics::select(const Target& target) const {
+    int selected = -1;
+    uint64_t best = 0;
+    for (auto const& summary : feds_) {
+        uint64_t value;
+        switch (target.policy) {
+            case TARGET_PEAK:
+            value = summary.occupancy.max;
+            break;
+            case TARGET_P99:
+            value = summary.occupancy.p99;
+            break;
+            case TARGET_LAYER:
+            value = summary.layerHits[target.layer];
+            break;
+            default:
+            // as Encoder::selectFED()
+            value = encoder_.hitsPerFED().at(summary.fed) / std::max(encoder_.totalEvents, 1);
+        }
+        if ((selected == -1) || (value > best)) {
+            selected = summary.fed;
+            best = value;
+        }
+    }
+    return selected;
+}
+
+int Analytics::write(std::string path) const {
+    int status = 1;
+    if (writeFEDs(path + "analytics_feds.csv") != 1)
+        status = 0;
+    if (writeChannels(path + "analytics_channels.csv") != 1)
+        status = 0;
+    if (writeRocs(path + "analytics_rocs.csv") != 1)
+        status = 0;
+    if (writeEvents(path + "analytics_events.csv") != 1)
+        status = 0;
+    if (writeHits(path + "analytics_hits.csv") != 1)
+        status = 0;
+    return status;
+}
+
+// mean,p50,p90,p99,max
+static std::ostream& operator<<(std::ostream& out, const Occupancy& occupancy) {
+    return out << occupancy.mean << ',' << occupancy.p50 << ',' << occupancy.p90 << ','
+               << occupancy.p99 << ',' << occupancy.max;
+}
+
+int Analytics::writeFEDs(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "fed,events,hits,mean,p50,p90,p99,max,layer1,layer2,layer3,layer4,layer5\n";
+    for (auto const& summary : feds_) {
+        file << summary.fed << ',' << summary.events << ',' << summary.hits << ','
+             << summary.occupancy;
+        for (int layer = 1; layer < 6; layer++)
+            file << ',' << summary.layerHits[layer];
+        file << '\n';
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+int Analytics::writeChannels(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "fed,channel,layer,mean,p50,p90,p99,max\n";
+    for (auto const& summary : feds_) {
+        for (int ch = 1; ch < 49; ch++) {
+            if (summary.channels[ch].max == 0)
+                continue;
+            file << summary.fed << ',' << ch << ',' << summary.layers[ch] << ','
+                 << summary.channels[ch] << '\n';
+        }
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+int Analytics::writeRocs(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "fed,channel,roc,layer,mean,p50,p90,p99,max\n";
+    for (auto const& summary : feds_) {
+        for (int ch = 1; ch < 49; ch++) {
+            for (int roc = 1; roc < 9; roc++) {
+                const Occupancy& occupancy = summary.rocs[(ch - 1) * 8 + roc - 1];
+                if (occupancy.max == 0)
+                    continue;
+                file << summary.fed << ',' << ch << ',' << roc << ',' << summary.layers[ch] << ','
+                     << occupancy << '\n';
+            }
+        }
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+int Analytics::writeEvents(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "fed,rank,event,hits,channel,channel_hits,roc_channel,roc,roc_hits\n";
+    for (auto const& summary : feds_) {
+        for (size_t rank = 0; rank < summary.worst.size(); rank++) {
+            const EventSummary& event = summary.worst[rank];
+            file << summary.fed << ',' << (rank + 1) << ',' << event.event << ','
+                 << event.hits << ',' << event.channel << ',' << event.channelHits << ','
+                 << event.rocChannel << ',' << event.roc << ',' << event.rocHits << '\n';
+        }
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+int Analytics::writeHits(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "fed,hits,events,channels,rocs\n";
+    for (auto const& summary : feds_) {
+        size_t rows = std::max({summary.eventHits.size(), summary.channelHits.size(),
+                                summary.rocHits.size()});
+        for (size_t hits = 0; hits < rows; hits++) {
+            uint64_t events = (hits < summary.eventHits.size()) ? summary.eventHits[hits] : 0;
+            uint64_t channels = (hits < summary.channelHits.size()) ? summary.channelHits[hits] : 0;
+            uint64_t rocs = (hits < summary.rocHits.size()) ? summary.rocHits[hits] : 0;
+            if ((events | channels | rocs) == 0)
+                continue;
+            file << summary.fed << ',' << hits << ',' << events << ','
+                 << channels << ',' << rocs << '\n';
+        }
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+// Occupancy Analytics
+// Summarizes every fed of the sorted hit store after
+// Encoder::process(), so the input is not read again.
+// Each fed is summarized by its own task.
+//
+// Occupancy is the number of hits in an event, of a whole fed,
+// a channel or a roc. Percentiles are nearest rank over the
+// events stored for the fed; an event without hits in a channel
+// or roc counts as zero for it.
+//
+// The summaries are written as CSV tables and can pick the
+// target fed by policies other than the highest average.
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include "Includes.h"
+#include "Encoder.h"
+
+// how the target fed is picked
+enum TargetPolicy {
+    TARGET_AVERAGE,  // highest average hits per event
+    TARGET_PEAK,     // most hits in one event
+    TARGET_P99,      // highest 99th percentile of hits per event
+    TARGET_LAYER     // highest average hits in the channels of a layer
+};
+
+struct Target {
+    TargetPolicy policy = TARGET_AVERAGE;
+    // layer 1-5 of TARGET_LAYER
+    int layer = 0;
+};
+
+// parses average, peak, p99 or layer:N, returns 0 if unknown
+int parseTarget(std::string text, Target& target);
+// name of a target as parsed by parseTarget()
+std::string targetName(const Target& target);
+
+// distribution of hits per event
+struct Occupancy {
+    double mean = 0.;
+    int p50 = 0;
+    int p90 = 0;
+    int p99 = 0;
+    int max = 0;
+};
+
+// one of the events with the most hits in a fed
+struct EventSummary {
+    int event = 0;
+    int hits = 0;
+    // channel with the most hits in the event
+    int channel = 0;
+    int channelHits = 0;
+    // roc with the most hits in the event, and its channel
+    int rocChannel = 0;
+    int roc = 0;
+    int rocHits = 0;
+};
+
+struct FEDSummary {
+    int fed = 0;
+    int events = 0;
+    uint64_t hits = 0;
+    Occupancy occupancy;
+    // layer of each channel in this fed, from its hits,
+    // 0 for channels without hits, index: channel id
+    int layers[49] = {0};
+    // hits in the channels of each layer, index: layer id
+    uint64_t layerHits[6] = {0};
+    // index: channel id
+    Occupancy channels[49];
+    // index: (channel id - 1) * 8 + roc id - 1
+    Occupancy rocs[48 * 8];
+    // events with the most hits, most first
+    std::vector<EventSummary> worst;
+    // events, channels in events and rocs in events
+    // with each number of hits, index: hits
+    std::vector<uint64_t> eventHits;
+    std::vector<uint64_t> channelHits;
+    std::vector<uint64_t> rocHits;
+};
+
+class Analytics {
+ private:
+  const Encoder& encoder_;
+  // events with the most hits kept per fed
+  size_t worstEvents_;
+  // in ascending fed order
+  std::vector<FEDSummary> feds_;
+  FEDSummary summarize(int fed) const;
+  int writeFEDs(std::string filename) const;
+  int writeChannels(std::string filename) const;
+  int writeRocs(std::string filename) const;
+  int writeEvents(std::string filename) const;
+  int writeHits(std::string filename) const;
+ public:
+  // encoder: processed with every fed in its store
+  Analytics(const Encoder& encoder, size_t worstEvents = 10)
+      : encoder_(encoder), worstEvents_(worstEvents) { }
+  virtual ~Analytics() { }
+
+  // summarizes every fed on up to threads threads
+  void run(int threads = 1);
+  const std::vector<FEDSummary>& feds() const { return feds_; }
+  // the fed picked by target, -1 if there are no feds.
+  // ties go to the lowest fed id
+  int select(const Target& target) const;
+  // writes the tables analytics_feds, analytics_channels,
+  // analytics_rocs, analytics_events and analytics_hits .csv,
+  // path is empty or ends with '/'
+  // returns 1 if every table was written
+  int write(std::string path = "") const;
+};
+
+#endif
@@ -1,92 +1,239 @@
 // Pixel Decoder
 // Anthony McIntyre, July 2018
 // Decodes binary file to pixels for consistency checking
+//
+// Files are memory mapped and decoded a block at a time.
+// Register sums use AVX2 when the cpu has it,
+// otherwise scalar bit tricks. Hit counts are kept in
+// plain arrays and moved into the histogram once in graph().
 
 #include "Decoder.h"
+#include "MappedFile.h"
+#include "Instrument.h"
+#include "Tasks.h"
 
-int Decoder::decodeRoc32(uint32_t line, int chanID, int count) {
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DECODER_X86
+#endif
+
+// sums of the roc fields in a register
+// 2 x 16 bits, 4 x 8 bits, 8 x 4 bits and 8 x 8 bits
+static inline uint32_t sum16x2(uint32_t line) {
+    return (line & 0xFFFF) + (line >> 16);
+}
+
+static inline uint32_t sum8x4(uint32_t line) {
+    line = (line & 0x00FF00FF) + ((line >> 8) & 0x00FF00FF);
+    return (line & 0xFFFF) + (line >> 16);
+}
+
+static inline uint32_t sum4x8(uint32_t line) {
+    line = (line & 0x0F0F0F0F) + ((line >> 4) & 0x0F0F0F0F);
+    return sum8x4(line);
+}
+
+static inline uint32_t sum8x8(uint64_t line) {
+    line = (line & 0x00FF00FF00FF00FFull) + ((line >> 8) & 0x00FF00FF00FF00FFull);
+    line = (line & 0x0000FFFF0000FFFFull) + ((line >> 16) & 0x0000FFFF0000FFFFull);
+    return (uint32_t)((line & 0xFFFFFFFFull) + (line >> 32));
+}
+
+// hit sums of registers in a block
+// format is the 2 bit block header
+//  0: 2 rocs, 32bit
+//  1: 4 rocs, 32bit
+//  2: 8 rocs, 32bit
+//  3: 8 rocs, 64bit
+static void sumScalar(const uint8_t* data, size_t registers, int format, uint32_t* sums) {
+    uint32_t line32;
+    uint64_t line64;
+    for (size_t i = 0; i < registers; i++) {
+        if (format == 3) {
+            std::memcpy(&line64, data + i * 8, 8);
+            sums[i] = sum8x8(line64);
+            continue;
+        }
+        std::memcpy(&line32, data + i * 4, 4);
+        if (format == 0)
+            sums[i] = sum16x2(line32);
+        else if (format == 1)
+            sums[i] = sum8x4(line32);
+        else
+            sums[i] = sum4x8(line32);
+    }
+}
+
+#ifdef DECODER_X86
+__attribute__((target("avx2")))
+static void sumAvx2(const uint8_t* data, size_t registers, int format, uint32_t* sums) {
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    const __m256i ones16 = _mm256_set1_epi16(1);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i low4 = _mm256_set1_epi8(0x0F);
+    size_t width = (format == 3) ? 8 : 4;
+    size_t i = 0;
+    if (format == 3) {
+        // low 32 bits of each 64-bit lane, in order
+        const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        for (; i + 4 <= registers; i += 4) {
+            __m256i line = _mm256_loadu_si256((const __m256i*)(data + i * 8));
+            __m256i s = _mm256_madd_epi16(_mm256_maddubs_epi16(line, ones8), ones16);
+            s = _mm256_add_epi32(s, _mm256_srli_epi64(s, 32));
+            s = _mm256_permutevar8x32_epi32(s, even);
+            _mm_storeu_si128((__m128i*)(sums + i), _mm256_castsi256_si128(s));
+        }
+    } else {
+        for (; i + 8 <= registers; i += 8) {
+            __m256i line = _mm256_loadu_si256((const __m256i*)(data + i * 4));
+            __m256i s;
+            if (format == 0) {
+                s = _mm256_add_epi32(_mm256_and_si256(line, low16), _mm256_srli_epi32(line, 16));
+            } else {
+                // nibbles are added into bytes first
+                if (format == 2)
+                    line = _mm256_add_epi8(_mm256_and_si256(line, low4),
+                                           _mm256_and_si256(_mm256_srli_epi16(line, 4), low4));
+                s = _mm256_madd_epi16(_mm256_maddubs_epi16(line, ones8), ones16);
+            }
+            _mm256_storeu_si256((__m256i*)(sums + i), s);
+        }
+    }
+    sumScalar(data + i * width, registers - i, format, sums + i);
+}
+#endif
+
+typedef void (*SumFunction)(const uint8_t*, size_t, int, uint32_t*);
+
+// picks the register sum for this cpu once
+static SumFunction selectSum() {
+#ifdef DECODER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return sumAvx2;
+#endif
+    return sumScalar;
+}
+
+static const SumFunction sumRegisters = selectSum();
+
+int Decoder::decodeRoc32(uint32_t line, int count) {
+    switch (count) {
+        case 2:
+            return sum16x2(line);
+        case 4:
+            return sum8x4(line);
+        case 8:
+            return sum4x8(line);
+    }
     int hits = 0;
-    uint32_t buf = 0;
     uint32_t bits = 32 / count;
-    for(uint32_t i = 0; i < count; i++) {
-        buf = line << (i * bits);
-        buf >>= (count * bits) - bits;
-        hits += (int)buf;
-    }
+    for (int i = 0; i < count; i++)
+        hits += (line >> (i * bits)) & ((1u << bits) - 1);
     return hits;
 }
 
-int Decoder::decodeRoc64(uint64_t line, int chanID, int count) {
+int Decoder::decodeRoc64(uint64_t line, int count) {
+    if (count == 8)
+        return sum8x8(line);
     int hits = 0;
-    uint64_t buf = 0;
     uint64_t bits = 64 / count;
-    for(uint64_t i = 0; i < count; i++) {
-        buf = line << (i * bits);
-        buf >>= (count * bits) - bits;
-        hits += (int)buf;
-    }
+    for (int i = 0; i < count; i++)
+        hits += (line >> (i * bits)) & ((1ull << bits) - 1);
     return hits;
 }
 
-int Decoder::open(std::string filename, int chanBase) {
-    std::ifstream file(filename.c_str(), std::ios::binary | std::ios::in | std::ios::ate);
-    const int FILESIZE = 8388612;
-    int blocksize = (FILESIZE - 4) / 16;
-    if ((int)file.tellg() != FILESIZE)
+void Decoder::count(const uint8_t* block, size_t size, int format, int chanID) {
+    const size_t CHUNK = 1024;
+    uint32_t sums[CHUNK];
+    size_t width = (format == 3) ? 8 : 4;
+    size_t registers = size / width;
+    std::vector<uint64_t>& counts = hitmap[chanID - 1];
+    for (size_t done = 0; done < registers; done += CHUNK) {
+        size_t n = std::min(CHUNK, registers - done);
+        sumRegisters(block + done * width, n, format, sums);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t hits = sums[i];
+            if (hits >= counts.size())
+                counts.resize(hits + 1, 0);
+            counts[hits]++;
+        }
+    }
+}
+
+void Decoder::updateMax() {
+    maxhits = 0;
+    for (int ch = 0; ch < 48; ch++) {
+        if (!hitmap[ch].empty())
+            maxhits = std::max(maxhits, (int)hitmap[ch].size() - 1);
+    }
+}
+
+int Decoder::open(std::string filename, int chanBase, std::ostream& out) {
+    ScopedTimer timer("decode");
+    const size_t FILESIZE = format_.hitBytes();
+    MappedFile file(filename);
+    if (!file.isOpen() || (file.size() != FILESIZE))
         return 0;
-    file.seekg(0);
+    const uint8_t* data = file.data();
     uint32_t headerBuffer;
-    uint32_t header;
-    uint32_t line32;
-    uint64_t line64;
-    file.read((char*)&headerBuffer, 4);
-    for (int i = 0; i < 16; i++) {
-        header = headerBuffer << (i * 2);
-        header >>= (30);
-        int chanID = chanBase + i;
-        std::cout << "Processing channel " << i << '\n';
-        int hits = 0;
-        switch (header) {
-            case 0:
-                for (int j = 0; j < blocksize / 4; j) {
-                    file.read( (char*) &line32, 4);
-                    hits = decodeRoc32(line32, chanID, 2);
-                    hFEDChan.Fill(chanID, hits);
-                    line32 = 0;
-                }
-                break;
-            case 1:
-                for (int j = 0; j < blocksize / 4; j++) {
-                    file.read( (char*) &line32, 4);
-                    hFEDChan.Fill(chanID, decodeRoc32(line32, chanID, 4));
-                    line32 = 0;
-                }
-                break;
-            case 2:
-                for (int j = 0; j < blocksize / 4; j++) {
-                    file.read( (char*) &line32, 4);
-                    hFEDChan.Fill(chanID, decodeRoc32(line32, chanID, 4));
-                    line32 = 0;
-                }
-                break;
-            case 3:
-                for (int j = 0; j < blocksize / 8; j++) {
-                    file.read( (char*) &line64, 8);
-                    hFEDChan.Fill(chanID, decodeRoc64(line64, chanID, 8));
-                    line64 = 0;
-                }
-                break;
-            default:
-                std::cout<<"Error: Incorrect header format.\n";
-        }
+    std::memcpy(&headerBuffer, data, 4);
+    for (int i = 0; i < format_.channels; i++) {
+        int header = (headerBuffer >> format_.headerShift(i)) & 3;
+        out << "Processing channel " << i << '\n';
+        count(data + Format::HEADERBYTES + i * format_.blockBytes, format_.blockBytes, header, chanBase + i);
     }
-    file.close();
+    updateMax();
+    timer.add(1, FILESIZE);
     return 1;
 }
 
-void Decoder::graph(std::string path) {
-    TCanvas* canvas = new TCanvas("canvas");
-    hFEDChan.Draw();
-    std::string filename = path + "histogram_binary.pdf";
-    canvas->Print(filename.c_str());
+int Decoder::decode(std::string path, int threads, std::ostream& out) {
+    ScopedTimer timer("decode");
+    const size_t FILESIZE = format_.hitBytes();
+    int files = format_.files;
+    int channels = format_.channels;
+    std::vector<MappedFile> mapped(files);
+    std::vector<uint32_t> headers(files, 0);
+    int status = 1;
+    for (int filenum = 0; filenum < files; filenum++) {
+        std::string name = "SRAMhit" + std::to_string(filenum) + ".bin";
+        if (!mapped[filenum].open(path + name) || (mapped[filenum].size() != FILESIZE)) {
+            out << "Error: Missing " << name << " in directory.\n";
+            mapped[filenum].close();
+            status = 0;
+            continue;
+        }
+        std::memcpy(&headers[filenum], mapped[filenum].data(), 4);
+        timer.add(1, FILESIZE);
+    }
+    // one task per channel block, each counts into its own channel
+    runTasks(files * channels, threads, [&](size_t block) {
+        int filenum = block / channels;
+        int i = block % channels;
+        if (!mapped[filenum].isOpen())
+            return;
+        int header = (headers[filenum] >> format_.headerShift(i)) & 3;
+        count(mapped[filenum].data() + Format::HEADERBYTES + i * format_.blockBytes,
+              format_.blockBytes, header, block + 1);
+    });
+    updateMax();
+    return status;
+}
+
+void Decoder::decodePix(uint32_t line, int& row, int& col, int& adc) {
+    row = (line >> 16) & 0x3FF;
+    col = (line >> 8) & 0x3F;
+    adc = line & 0xFF;
+}
+
+void Decoder::graph(std::string path, int formats) {
+    ScopedTimer timer("decode.graph");
+    Histogram histogram("hBinaryFED" + std::to_string(fed_),
+                        "Hits Per Channel in FED #" + std::to_string(fed_) +
+                        " Binary Files;Channel;Number of Hits",
+                        bins_);
+    for (int ch = 0; ch < 48; ch++)
+        histogram.add(ch + 1, hitmap[ch]);
+    histogram.write(path + "histogram_binary", formats);
 }
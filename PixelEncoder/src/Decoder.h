@@ -6,18 +6,54 @@
 #define PIXELDECODER_H
 
 #include "Includes.h"
+#include "Format.h"
+#include "Histogram.h"
 
 class Decoder {
 private:
-    std::map<int, std::vector<int> > hitmap;
+    // number of registers with a given hit count, per channel
+    // hitmap[channel - 1][hits]
+    std::vector<uint64_t> hitmap[48];
     int maxhits;
+    // fed and histogram range given to the constructor
+    int fed_;
+    int bins_;
+    // geometry of the SRAMhit files
+    Format format_;
+    // adds the hit counts of one block to hitmap[chanID - 1],
+    // blocks of different channels can be counted at once
+    void count(const uint8_t* block, size_t size, int format, int chanID);
+    // sets maxhits from hitmap
+    void updateMax();
 public:
-    Decoder() { maxhits = 0; hitmap.clear(); }
+    // fed: fed id the files were encoded from, names the histogram
+    // bins: hit count bins of the histogram, FEDStats::histogramBins()
+    // of the fed so it matches the source histogram
+    // format: geometry of the files, as given to the encoder
+    Decoder(int fed = 0, int bins = 256, const Format& format = defaultFormat())
+        : fed_(fed), bins_(bins), format_(format) {
+        maxhits = 0;
+    }
     virtual ~Decoder() { }
-    int open(std::string file, int chanBase);
+    // decodes a SRAMhit file, chanBase is the channel of its first block
+    // returns 1 on success, 0 if the file is missing or the wrong size
+    int open(std::string file, int chanBase, std::ostream& out = std::cout);
+    // decodes every SRAMhit#.bin of the format in path,
+    // path is empty or ends with '/'
+    // the 48 channel blocks are decoded on up to threads threads
+    // returns 1 on success, 0 if a file is missing or the wrong size
+    int decode(std::string path, int threads = 1, std::ostream& out = std::cout);
+    // sum of count equal width roc fields in a register
     int decodeRoc32(uint32_t line, int count);
     int decodeRoc64(uint64_t line, int count);
-    void process(std::string path);
+    // splits a SRAMpix word 0x[25:16]00[13:8][7:0]
+    static void decodePix(uint32_t line, int& row, int& col, int& adc);
+    // registers per hit count for a channel
+    const std::vector<uint64_t>& hits(int chanID) const { return hitmap[chanID - 1]; }
+    int maxHits() const { return maxhits; }
+    // draws the hits per channel in the binary files
+    // formats: PlotFormat flags of the histogram_binary files
+    void graph(std::string path, int formats = PLOT_PDF);
 };
 
 #endif
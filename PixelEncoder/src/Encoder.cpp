@@ -17,50 +17,71 @@
 
 
 #include "Encoder.h"
+#include "MappedFile.h"
+#include "Tasks.h"
 
-// checks if pixel is already stored and adds to container
+// adds pixel to container, duplicates are removed by process()
 // for events with zero hits, add layer 0
-int Encoder::add(int event,
-                     int fed,
-                     int layer,
-                     int ch,
-                     int roc,
-                     int row,
-                     int col,
-                     int adc) {
-    eventStore_[event] = 1;
+void Encoder::add(int event,
+                  int fed,
+                  int layer,
+                  int ch,
+                  int roc,
+                  int row,
+                  int col,
+                  int adc) {
     // layer 0 is for events with 0 hits
     if ((layer > 0) || (roc > 0)) {
-        // merge row and col into unique number by bit shifting them
-        uint32_t rowcol = ((uint32_t)row << 16 | (uint32_t)col << 8);
-        ChannelLayer_[ch] = layer;
-        auto pix = storage[fed][event][ch][roc].find(rowcol);
-        if (pix == storage[fed][event][ch][roc].end()) {
-            storage[fed][event][ch][roc][rowcol] = (uint32_t)adc;
-            hitspFED_[fed] += 1;
-            // return 0 for no duplicate counting
-            return 0;
-        } else {
-            // duplicate found, return 1
-            return 1;
-        }
+        storage.add(event, fed, layer, ch, roc, row, col, adc);
     } else {
-        zeroEvents_[fed][event] += 1;
-        for (int c = 1; c < 49; c++){
-            storage[fed][event][c][-1][(uint32_t)(0)] = (uint32_t)(0);
-        }
-        return 0;
+        storage.addZero(event, fed);
     }
 }
 
-void Encoder::process() {
+void Encoder::add(size_t index,
+                  int event,
+                  int fed,
+                  int layer,
+                  int ch,
+                  int roc,
+                  int row,
+                  int col,
+                  int adc) {
+    if ((layer > 0) || (roc > 0)) {
+        storage.set(index, event, fed, layer, ch, roc, row, col, adc);
+    } else {
+        storage.setZero(index, event, fed);
+    }
+}
+
+void Encoder::add(const HitColumns& hits) {
+    size_t base = storage.size();
+    storage.resize(base + hits.count);
+    // each part fills its own slice of the store
+    const size_t PART = 65536;
+    int parts = (int)std::min((size_t)threads_, std::max((size_t)1, hits.count / PART));
+    runTasks(parts, parts, [&](size_t part) {
+        size_t begin = hits.count * part / parts;
+        size_t end = hits.count * (part + 1) / parts;
+        for (size_t i = begin; i < end; i++) {
+            add(base + i, hits.event[i], hits.fed[i], hits.layer[i], hits.channel[i],
+                hits.roc[i], hits.row[i], hits.col[i], (hits.adc != nullptr) ? hits.adc[i] : 0);
+        }
+    });
+}
+
+void Encoder::setCounts(const std::map<int, int>& hitspFED, int events) {
+    hitspFED_ = hitspFED;
+    totalEvents = events;
+    counted_ = true;
+}
+
+int Encoder::selectFED() {
     haFEDhit = 0;
     totalHits = 0;
-    totalZeroEvents = 0;
-    hhRoc = 0;
-    hhChan = 0;
-    totalEvents = eventStore_.size();
     totalFEDs = hitspFED_.size();
+    if (totalEvents == 0)
+        return haFEDID;
     for (auto const& fid : hitspFED_) {
         int avg = fid.second / totalEvents;
         totalHits += fid.second;
@@ -69,34 +90,368 @@ void Encoder::process() {
             haFEDID = fid.first;
         }
     }
-    totalZeroEvents = zeroEvents_[haFEDID].size();
-    for (auto const& event : storage[haFEDID]) {
-        for (auto const& ch : event.second) {
-            int hits = 0;
-            for (auto const& roc : ch.second) {
-                if ((roc.second.size() > 15) && (ChannelLayer_[ch.first] > 2))
-                    rocHigHitpFile_ = true;
-                if (roc.first > 0) {
-                    if (roc.second.size() > hhRoc) {
-                        hhRoc = roc.second.size();
+    return haFEDID;
+}
+
+void Encoder::process() {
+    ScopedTimer timer("process");
+    timer.add(storage.size(), storage.size() * sizeof(Hit));
+    storage.sort();
+    totalDuplicates = storage.duplicates();
+    if (!counted_) {
+        hitspFED_.clear();
+        // count hits per fed and collect event ids in one pass
+        std::vector<int> events;
+        const Hit* last = nullptr;
+        for (const Hit& hit : storage) {
+            if ((last == nullptr) || (hit.fed != last->fed) || (hit.event != last->event))
+                events.push_back(hit.event);
+            if (hit.ch != 0)
+                hitspFED_[hit.fed] += 1;
+            last = &hit;
+        }
+        std::sort(events.begin(), events.end());
+        totalEvents = std::unique(events.begin(), events.end()) - events.begin();
+    }
+    setTarget(selectFED());
+}
+
+void Encoder::setTarget(int fedID) {
+    haFEDID = fedID;
+    auto hits = hitspFED_.find(fedID);
+    haFEDhit = ((hits != hitspFED_.end()) && (totalEvents != 0)) ? hits->second / totalEvents : 0;
+    targetStats_ = stats(haFEDID, threads_);
+    targetStatsFED_ = haFEDID;
+    totalZeroEvents = targetStats_.zeroEvents;
+    hhRoc = targetStats_.hhRoc;
+    hhChan = targetStats_.hhChan;
+}
+
+// adds the statistics of part of a fed into result
+static void mergeStats(FEDStats& result, const FEDStats& part) {
+    result.hhChan = std::max(result.hhChan, part.hhChan);
+    result.hhRoc = std::max(result.hhRoc, part.hhRoc);
+    result.zeroEvents += part.zeroEvents;
+    result.rocHigHit = result.rocHigHit || part.rocHigHit;
+    for (int ch = 1; ch < 49; ch++) {
+        result.used[ch] = result.used[ch] || part.used[ch];
+        result.layers[ch] = std::max(result.layers[ch], part.layers[ch]);
+        std::vector<uint64_t>& counts = result.chanHits[ch];
+        if (counts.size() < part.chanHits[ch].size())
+            counts.resize(part.chanHits[ch].size(), 0);
+        for (size_t hits = 0; hits < part.chanHits[ch].size(); hits++)
+            counts[hits] += part.chanHits[ch][hits];
+    }
+}
+
+FEDStats Encoder::stats(int fedID, int threads) const {
+    auto fed = storage.fed(fedID);
+    // split on event boundaries, a zero marker stays with its event
+    std::vector<const Hit*> bounds(1, fed.first);
+    size_t size = fed.second - fed.first;
+    for (int part = 1; part < threads; part++) {
+        const Hit* p = std::max(fed.first + size * part / threads, bounds.back());
+        while ((p != fed.second) && (p != fed.first) && (p->event == (p - 1)->event))
+            p++;
+        bounds.push_back(p);
+    }
+    bounds.push_back(fed.second);
+
+    std::vector<FEDStats> parts(threads);
+    runTasks(threads, threads, [&](size_t part) {
+        FEDStats& result = parts[part];
+        forEachEvent(bounds[part], bounds[part + 1], [&](int, bool zero, const Hit* first, const Hit* last) {
+            if (zero)
+                result.zeroEvents++;
+            int chanHits[49] = {0};
+            const Hit* p = first;
+            while (p != last) {
+                int ch = p->ch;
+                int hits = 0;
+                if (!zero && (ch < 49))
+                    result.used[ch] = true;
+                while ((p != last) && (p->ch == ch)) {
+                    // count pixels in this roc
+                    const Hit* r = p;
+                    while ((r != last) && (r->ch == ch) && (r->roc == p->roc))
+                        r++;
+                    int rocHits = r - p;
+                    // the layer of the fed's own channel, from the hit;
+                    // if a fed's hits disagree the highest layer is kept
+                    if ((ch < 49) && (p->layer > result.layers[ch]))
+                        result.layers[ch] = p->layer;
+                    if ((rocHits > 15) && (p->layer > 2))
+                        result.rocHigHit = true;
+                    if (p->roc > 0) {
+                        if (rocHits > result.hhRoc) {
+                            result.hhRoc = rocHits;
+                        }
+                        hits += rocHits;
+                        if ((ch < 49) && (p->roc < 9))
+                            chanHits[ch] += rocHits;
                     }
-                    hits += roc.second.size();
+                    p = r;
                 }
+                if (hits > result.hhChan) {
+                    result.hhChan = hits;
+                }
+            }
+            for (int ch = 1; ch < 49; ch++) {
+                std::vector<uint64_t>& counts = result.chanHits[ch];
+                if ((size_t)chanHits[ch] >= counts.size())
+                    counts.resize(chanHits[ch] + 1, 0);
+                counts[chanHits[ch]]++;
+            }
+        });
+    });
+    for (int part = 1; part < threads; part++)
+        mergeStats(parts[0], parts[part]);
+    return parts[0];
+}
+
+FEDStats Encoder::fedStats(int fedID) const {
+    if (fedID == targetStatsFED_)
+        return targetStats_;
+    return stats(fedID);
+}
+
+std::vector<int> Encoder::feds() const {
+    std::vector<int> ids;
+    for (auto const& fid : hitspFED_)
+        ids.push_back(fid.first);
+    return ids;
+}
+
+void Encoder::blockTypes(const FEDStats& stats, uint32_t* types) const {
+    for (int ch = 1; ch < 49; ch++) {
+        if (!stats.used[ch])
+            types[ch - 1] = 0;
+        else if (stats.layers[ch] == 1)
+            types[ch - 1] = 0;
+        else if (stats.layers[ch] == 2)
+            types[ch - 1] = 1;
+        else
+            types[ch - 1] = stats.rocHigHit ? 3 : 2;
+    }
+}
+
+void Encoder::encode(int targetFED,
+                     std::string path,
+                     std::ostream& out,
+                     bool onlyChanged,
+                     ImageWriter* writer) const {
+    Images images;
+    build(targetFED, images, out);
+    ImageWriter local;
+    ImageWriter& files = (writer != nullptr) ? *writer : local;
+    int unchanged = 0;
+    for (int filenum = 0; filenum < (int)images.hit.size(); filenum++) {
+        for (int pix = 0; pix < 2; pix++) {
+            // without the adc column the pixel images are incomplete
+            if (pix && !(outputs_ & OUT_PIXELS))
+                continue;
+            std::string filename = path + (pix ? "SRAMpix" : "SRAMhit") + std::to_string(filenum) + ".bin";
+            std::vector<uint8_t>& image = pix ? images.pix[filenum] : images.hit[filenum];
+            if (onlyChanged && sameImage(filename, image))
+                unchanged++;
+            else
+                files.submit(filename, std::move(image));
+        }
+    }
+    if (onlyChanged)
+        out << "Unchanged binary files: " << unchanged << '\n';
+    if (writer == nullptr)
+        local.wait(out);
+}
+
+// hit register packer of one block format.
+// counts holds 8 roc hit counts per register, roc 1 is the
+// most significant field. Counts are cut to the field width.
+template <int Rocs, int Bits, typename Register>
+struct HitPacker {
+    static void pack(const uint16_t* counts, size_t registers, uint8_t* out) {
+        const Register mask = (Register)((1ull << Bits) - 1);
+        for (size_t i = 0; i < registers; i++) {
+            Register line = 0;
+            for (int r = 0; r < Rocs; r++)
+                line |= ((Register)counts[i * 8 + r] & mask) << ((Rocs - 1 - r) * Bits);
+            std::memcpy(out + i * sizeof(Register), &line, sizeof(Register));
+        }
+    }
+};
+
+// SRAMpix words of n pixels, 0x[row][col][adc]
+static void packPixels(const Hit* pix, size_t n, uint8_t* out) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t address = ((uint32_t)pix[i].row << 16 |
+                            (uint32_t)pix[i].col << 8 |
+                            (uint32_t)pix[i].adc);
+        std::memcpy(out + i * 4, &address, 4);
+    }
+}
+
+// register width in bytes of a block format
+static inline size_t registerWidth(uint32_t type) {
+    return (type == 3) ? 8 : 4;
+}
+
+// packs registers of one block, dispatched once per block
+static void packBlock(uint32_t type, const uint16_t* counts, size_t registers, uint8_t* out) {
+    switch (type) {
+        case 0:
+        HitPacker<2, 16, uint32_t>::pack(counts, registers, out);
+        break;
+        case 1:
+        HitPacker<4, 8, uint32_t>::pack(counts, registers, out);
+        break;
+        case 2:
+        HitPacker<8, 4, uint32_t>::pack(counts, registers, out);
+        break;
+        default:
+        HitPacker<8, 8, uint64_t>::pack(counts, registers, out);
+    }
+}
+
+// These files have to be an exact file size.
+// So it loops over the data until the file size is met.
+// The sizes come from the format, for the GLIB board
+// 2^21 32bit registers or around 8.39 MB
+
+// what buildFile() consumed for one SRAM file pair
+struct FileResult {
+    // events, one register per block each
+    size_t registers = 0;
+    size_t pixWords = 0;
+    int hitCh = 0;
+    // images filled before the last event
+    bool full = false;
+};
+
+// builds SRAMhit# and SRAMpix# from the events in [first, last).
+// Hits per roc are counted for a chunk of events at a time,
+// then each block packs the chunk with the packer of its format
+// straight into the first period of the image.
+// F is a FormatTraits type, the geometry is known at compile time.
+template <typename F>
+static FileResult buildFile(int filenum,
+                            const Hit* first,
+                            const Hit* last,
+                            const uint32_t* types,
+                            std::vector<uint8_t>& hitImage,
+                            std::vector<uint8_t>& pixImage) {
+    // events counted before packing
+    const size_t CHUNK = 4096;
+    FileResult result;
+    const size_t BLOCKBYTES = F::blockBytes;
+    const size_t PIXWORDS = F::pixWords;
+    const int CHANNELS = F::channels;
+    hitImage.resize(F::hitBytes);
+    uint32_t header = 0;
+    for (int block = 0; block < CHANNELS; block++)
+        header = (header << 2 | types[block + (filenum * CHANNELS)]);
+    std::memcpy(hitImage.data(), &header, Format::HEADERBYTES);
+    // pixel addresses go straight into the pixel image
+    pixImage.resize(F::pixBytes);
+
+    // hits per roc of the chunk, CHUNK events of 8 rocs per channel
+    std::vector<uint16_t> counts((size_t)CHANNELS * CHUNK * 8, 0);
+    size_t slot = 0;
+    // registers of the block that holds the most
+    size_t maxRegisters = 0;
+    for (int block = 0; block < CHANNELS; block++)
+        maxRegisters = std::max(maxRegisters, BLOCKBYTES / registerWidth(types[block + (filenum * CHANNELS)]));
+    auto flush = [&]() {
+        for (int block = 0; block < CHANNELS; block++) {
+            uint32_t type = types[block + (filenum * CHANNELS)];
+            size_t width = registerWidth(type);
+            size_t capacity = BLOCKBYTES / width;
+            if (result.registers < capacity) {
+                packBlock(type, counts.data() + block * CHUNK * 8,
+                          std::min(slot, capacity - result.registers),
+                          hitImage.data() + Format::HEADERBYTES + block * BLOCKBYTES + result.registers * width);
             }
-            if (hits > hhChan) {
-                hhChan = hits;
+        }
+        result.registers += slot;
+        slot = 0;
+        std::fill(counts.begin(), counts.end(), 0);
+    };
+    int firstCh = filenum * CHANNELS + 1;
+    int lastCh = filenum * CHANNELS + CHANNELS;
+    // loop over events until every block and the pixel image are full
+    forEachEvent(first, last, [&](int, bool zero, const Hit* pix, const Hit* end) {
+        // if event is registered as a zero event all
+        // channels get zero hits
+        if (!zero) {
+            while ((pix != end) && (pix->ch < firstCh))
+                pix++;
+            const Hit* fileEnd = pix;
+            while ((fileEnd != end) && (fileEnd->ch <= lastCh))
+                fileEnd++;
+            // pixels of the file's channels are next to each other
+            // in (channel, roc, row, col) order
+            size_t n = fileEnd - pix;
+            if (result.pixWords < PIXWORDS) {
+                packPixels(pix, std::min(n, PIXWORDS - result.pixWords),
+                           pixImage.data() + result.pixWords * 4);
+            }
+            result.pixWords += n;
+            int prevCh = 0;
+            for (; pix != fileEnd; pix++) {
+                int ch = pix->ch;
+                if (ch != prevCh)
+                    result.hitCh++;
+                prevCh = ch;
+                if ((pix->roc > 0) && (pix->roc < 9))
+                    counts[((ch - firstCh) * CHUNK + slot) * 8 + (pix->roc - 1)]++;
             }
         }
+        if (++slot == CHUNK)
+            flush();
+        result.full = (result.registers + slot >= maxRegisters) &&
+                      (result.pixWords >= PIXWORDS);
+        return !result.full;
+    });
+    flush();
+
+    // Each image repeats the first period to the end.
+    for (int block = 0; block < CHANNELS; block++) {
+        uint8_t* blockStart = hitImage.data() + Format::HEADERBYTES + block * BLOCKBYTES;
+        size_t width = registerWidth(types[block + (filenum * CHANNELS)]);
+        Encoder::tile(blockStart, BLOCKBYTES, blockStart,
+                      std::min(result.registers * width, BLOCKBYTES));
     }
+    Encoder::tile(pixImage.data(), pixImage.size(), pixImage.data(),
+                  std::min(result.pixWords * 4, pixImage.size()));
+    return result;
 }
 
-// convert data in map structure to binary format
+typedef FileResult (*BuildKernel)(int, const Hit*, const Hit*, const uint32_t*,
+                                  std::vector<uint8_t>&, std::vector<uint8_t>&);
+
+// buildFile() of the listed format with the name of format, or nullptr
+template <typename... F>
+static BuildKernel buildKernel(const Format& format, FormatList<F...>) {
+    BuildKernel kernel = nullptr;
+    ((kernel = ((kernel == nullptr) && (std::strcmp(format.name, F::name) == 0)) ? buildFile<F> : kernel), ...);
+    return kernel;
+}
+
+// convert data in hit store to binary format
 // and place in a buffer for file writing.
-void Encoder::encode(int targetFED) {
-    // These are buffers for writing the data to files
-    // 1 block for each channel
-    // 16 channels per file
-    std::vector<uint64_t> RocFileBuffer[48];
+// The three file pairs are built on up to three threads.
+Images Encoder::images(int targetFED) const {
+    Images images;
+    // a stream without a buffer drops the messages
+    std::ostream discard(nullptr);
+    build(targetFED, images, discard);
+    return images;
+}
+
+void Encoder::build(int targetFED, Images& images, std::ostream& out) const {
+    ScopedTimer timer("build");
+    FEDStats targetStats = fedStats(targetFED);
+    // 64-bit hit registers if any roc has too many hits for 4 bits
+    bool rocHigHitpFile = targetStats.rocHigHit;
     // For the header file of the SRAMhit files
     // indicates the binary format used
     // 2 bits per block
@@ -105,182 +460,95 @@ void Encoder::encode(int targetFED) {
     // 2: 8 rocs, 32bit
     // 3: 8 rocs, 64bit
     uint32_t BlockType[48];
-    int emptyCh = 0;
-    int hitCh = 0;
-    // buffer for pixel address binary
-    std::vector<uint32_t> PixAdd[3];
-    // buffer for hits per roc
-    std::unordered_map<int, uint64_t> hits;
-    // loop over events in target fed id
-    for (auto const& event : storage[haFEDID]) {
-        // loop over all channels
-        for (int ch = 1; ch < 49; ch++) {
-            // if event is registered as a zero event
-            // or channel has no registered hits
-            // push zero hits for channel
-            if ((event.second.count(ch) == 0) || (zeroEvents_[haFEDID][event.first] > 0)) {
-                RocFileBuffer[ch - 1].push_back((uint64_t)0);
-                emptyCh++;
-            } else {
-                hitCh++;
-                for (auto const& roc : storage[haFEDID][event.first][ch]) {
-                    for (auto const& pix : roc.second) {
-                        // convert pixel addresses into binary
-                        // and push into pix buffer
-                        uint32_t addressBuffer = 0;
-                        addressBuffer = (pix.first | pix.second);
-                        int index = (int)ceil((float)ch / 16.0) - 1;
-                        PixAdd[index].push_back(addressBuffer);
-                    }
-                    // store rocs that have registered hits
-                    hits[roc.first] = (uint64_t)roc.second.size();
-                }
-                uint64_t hitBuffer = 0;
-                switch (ChannelLayer_[ch]) {
-                    case 1:
-                    BlockType[ch - 1] = 0;
-                    for (int r = 1; r < 3; r++) {
-                        if (hits.count(r) > 0)
-                            hitBuffer = (hitBuffer << 16 | hits[r]);
-                        else
-                            hitBuffer <<= 16;
-                    }
-                    break;
-                    case 2:
-                    BlockType[ch - 1] = 1;
-                    for (int r = 1; r < 5; r++) {
-                        if (hits.count(r) > 0)
-                            hitBuffer = (hitBuffer << 8 | hits[r]);
-                        else
-                            hitBuffer <<= 8;
-                    }
-                    break;
-                    default:
-                    if (rocHigHitpFile_) {
-                        BlockType[ch - 1] = 3;
-                        for (int r = 1; r < 9; r++) {
-                            if (hits.count(r) > 0)
-                                hitBuffer = (hitBuffer << 8 | hits[r]);
-                            else
-                                hitBuffer <<= 8;
-                        }
-                    } else {
-                        BlockType[ch - 1] = 2;
-                        for (int r = 1; r < 9; r++) {
-                            if (hits.count(r) > 0)
-                                hitBuffer = (hitBuffer << 4 | hits[r]);
-                            else
-                                hitBuffer <<= 4;
-                        }
-                    }
-                }
-                RocFileBuffer[ch - 1].push_back(hitBuffer);
-                hits.clear();
-            }
-        }
+    blockTypes(targetStats, BlockType);
+    BuildKernel kernel = buildKernel(format_, Formats());
+    if (kernel == nullptr) {
+        out << "Error: Unknown SRAM format " << format_.name << '\n';
+        return;
     }
+    int files = format_.files;
+    int channels = format_.channels;
+    images.hit.resize(files);
+    images.pix.resize(files);
+    std::vector<FileResult> results(files);
+    auto fed = storage.fed(targetFED);
+    runTasks(files, std::min(threads_, files), [&](size_t filenum) {
+        results[filenum] = kernel(filenum, fed.first, fed.second, BlockType,
+                                  images.hit[filenum], images.pix[filenum]);
+    });
 
     // checks if buffer sizes match
-    for (int i = 0; i < 48; i++) {
-        std::cout << "Roc Hit Buffer " << i << " size: " 
-                  << RocFileBuffer[i].size() << '\n'; 
-        //if (RocFileBuffer[i].size() != RocFileBuffer[i - 1].size())
-        //    throw std::length_error("Block sizes do not match.");
+    int hitCh = 0;
+    int emptyCh = 0;
+    for (int filenum = 0; filenum < files; filenum++) {
+        hitCh += results[filenum].hitCh;
+        emptyCh += (int)results[filenum].registers * channels - results[filenum].hitCh;
     }
-    for (int i = 0; i < 3; i++) {
-        std::cout << "Pixel Address Buffer " << i
-                  << "size: " << PixAdd[i].size() << '\n';
+    // registers and pixel words of each file pair go to the run report
+    for (int i = 0; i < files; i++) {
+        std::string name = "fed" + std::to_string(targetFED) + "_sram" + std::to_string(i);
+        Instrument::stat(name + "_registers", results[i].registers);
+        Instrument::stat(name + "_pixel_words", results[i].pixWords);
     }
-    std::cout << "\nNumber of channels with zero hits: " << emptyCh
-              << "\nNumer of channels with hits: " << hitCh
-              << "\n64-bit binary files: ";
-    if (rocHigHitpFile_)
-        std::cout<<"True\n";
+    for (int i = 0; i < files; i++) {
+        if (results[i].full)
+            out << "\nSRAM files " << i << " full after " << results[i].registers
+                << " events, later events are not encoded.";
+    }
+    out << "\nNumber of channels with zero hits: " << emptyCh
+        << "\nNumer of channels with hits: " << hitCh
+        << "\n64-bit binary files: ";
+    if (rocHigHitpFile)
+        out << "True\n";
     else
-        std::cout<<"False\n";
-
-    // These files have to be an exact file size.
-    // So it loops over the data until the file size is met.
-    // The size in this case is 2^21 32bit registers or around 8.39 MB
-    std::string filename;
-    std::ofstream glibhit[3];
-    std::ofstream glibpix[3];
-    // Filesize in registers
-    const int FILESIZE = 2097152; // 2^21
-    const int BLOCKSIZE = 131072; // 2^17
-    // begin writing files.
-    for (int filenum = 0; filenum < 3; filenum++) {
-        filename = "SRAMhit" + std::to_string(filenum) + ".bin";
-        glibhit[filenum].open(filename.c_str(), std::ios::binary | std::ios::out);
-        filename = "SRAMpix" + std::to_string(filenum) + ".bin";
-        glibpix[filenum].open(filename.c_str(), std::ios::binary | std::ios::out);
-        
-        int position = 0;
-        
-        uint32_t header = 0;
-        for (int block = 0; block < 16; block++) {
-            int index = block + (filenum * 16);
-            header = (header << 2 | BlockType[index]);
-        }
-        glibhit[filenum].write((char*)&header, 4);
-        
-        for (int block = 0; block < 16; block++) {
-            position = 0;
-            int index = block + (filenum * 16);
-            if (rocHigHitpFile_) {
-                for (int registers = 0; registers < BLOCKSIZE; registers += 2) {
-                    if (position == RocFileBuffer[index].size())
-                        position = 0;
-                    glibhit[filenum].write((char*)&RocFileBuffer[index][position], 8);
-                    position++;
-                }
-            } else {
-                for (int registers = 0; registers < BLOCKSIZE; registers++) {
-                    if (position == RocFileBuffer[index].size())
-                        position = 0;
-                    glibhit[filenum].write((char*)&RocFileBuffer[index][position], 4);
-                    position++;
-                }
-            }
-        }
-        
-        position = 0;
-        for (int registers = 0; registers < FILESIZE; registers++) {
-            if ((unsigned int)position == PixAdd[filenum].size())
-                position = 0;
-            glibpix[filenum].write((char*)&PixAdd[filenum][position], 4);
-            position++;
-        }
-        glibhit[filenum].close();
-        glibpix[filenum].close();
+        out << "False\n";
+    for (int i = 0; i < files; i++)
+        timer.add(results[i].pixWords, images.hit[i].size() + images.pix[i].size());
+}
+
+void Encoder::tile(uint8_t* image, size_t size, const uint8_t* source, size_t sourceSize) {
+    if (sourceSize == 0) {
+        std::memset(image, 0, size);
+        return;
     }
+    size_t filled = std::min(sourceSize, size);
+    if (source != image)
+        std::memcpy(image, source, filled);
+    // double the copied region, it stays a whole number of repeats
+    while (filled < size) {
+        size_t count = std::min(filled, size - filled);
+        std::memcpy(image + filled, image, count);
+        filled += count;
+    }
+}
+
+int Encoder::writeImage(std::string filename, const std::vector<uint8_t>& image) {
+    ScopedTimer timer("write");
+    timer.add(1, image.size());
+    std::ofstream file(filename.c_str(), std::ios::binary | std::ios::out);
+    if (!file.is_open())
+        return 0;
+    file.write((const char*)image.data(), image.size());
+    file.close();
+    return file.good() ? 1 : 0;
 }
 
+bool Encoder::sameImage(std::string filename, const std::vector<uint8_t>& image) {
+    MappedFile file(filename);
+    return file.isOpen() && (file.size() == image.size()) &&
+           (std::memcmp(file.data(), image.data(), image.size()) == 0);
+}
 
-void Encoder::graph() {
-    TCanvas* canvas = new TCanvas("canvas");
-    TH2D *hChanROC[48], *hFEDChan;
-    std::string title = "Hits Per Channel in FED #" + std::to_string(haFEDID) +
-                      " in Each Channel;Channel;Number of Hits";
-    std::string name = "hChanFED" + std::to_string(haFEDID);
-    hFEDChan = new TH2D(name.c_str(), title.c_str(), 48, 1., 49.,
-                      ((float)hhChan + ((float)hhChan * 0.5)), -0.5,
-                      ((float)hhChan + ((float)hhChan * 0.5) - 0.5));
-    hFEDChan->SetOption("COLZ");
-    int chanHits = 0;
-    for (auto const& event : storage[haFEDID]) {
-        for (int ch = 1; ch < 49; ch++) {
-            for (int rc = 1; rc < 9; rc++) {
-                auto roc = storage[haFEDID][event.first][ch].find(rc);
-                if (roc != storage[haFEDID][event.first][ch].end()) {
-                    chanHits += storage[haFEDID][event.first][ch][rc].size();
-                }
-            }
-            hFEDChan->Fill(ch, chanHits);
-            chanHits = 0;
-        }
-    }
-    hFEDChan->Draw();
-    title = "Title:Source - Hits per channel in FED #" + std::to_string(haFEDID);
-    canvas->Print("histogram_source.pdf", title.c_str());
+void Encoder::graph(int targetFED, std::string path, int formats) const {
+    ScopedTimer timer("graph");
+    FEDStats targetStats = fedStats(targetFED);
+    Histogram histogram("hChanFED" + std::to_string(targetFED),
+                        "Hits Per Channel in FED #" + std::to_string(targetFED) +
+                        " in Each Channel;Channel;Number of Hits",
+                        targetStats.histogramBins());
+    for (int ch = 1; ch < 49; ch++)
+        histogram.add(ch, targetStats.chanHits[ch]);
+    timer.add(histogram.entries());
+    std::string title = "Title:Source - Hits per channel in FED #" + std::to_string(targetFED);
+    histogram.write(path + "histogram_source", formats, title);
 }
@@ -9,46 +9,91 @@
 #define ENCODER_H
 
 #include "Includes.h"
+#include "Format.h"
+#include "Histogram.h"
+#include "HitStore.h"
+#include "ImageWriter.h"
+#include "Instrument.h"
 
+// outputs of a run, the reader only loads the columns they use
+enum Output {
+    OUT_STATS = 1,   // counts and fed statistics, always made
+    OUT_HITS = 2,    // SRAMhit files
+    OUT_PIXELS = 4,  // SRAMpix files
+    OUT_GRAPHS = 8,  // histograms
+    OUT_ALL = 15
+};
+
+// statistics of one fed
+struct FEDStats {
+    // highest hits in a channel
+    int hhChan = 0;
+    // highest hits in a roc
+    int hhRoc = 0;
+    // events with zero hits
+    int zeroEvents = 0;
+    // a roc in layer 3-4 or FPix has more than 15 hits,
+    // hit files then use 64-bit registers
+    bool rocHigHit = false;
+    // layer of each channel in this fed, from its hits,
+    // 0 for channels without hits, index: channel id
+    int layers[49] = {0};
+    // channels with hits outside zero events, index: channel id
+    bool used[49] = {false};
+    // events in the fed with each number of hits in rocs 1-8
+    // of a channel, index: channel id, then hits
+    std::vector<uint64_t> chanHits[49];
+
+    // hit count bins of the source and binary histograms, so both overlay
+    int histogramBins() const { return hhChan * 3 / 2 + 1; }
+};
 
-// Container types
-// row, col as key, adc as value
-//    row, col is bit shifted
-//    row is shifted 16, col is shifted 8
-using Pixels = std::unordered_map<uint32_t, uint32_t>;
-// roc id as key and pixel map as value
-using ROCs = std::map<int, Pixels>;
-// channel id as key and roc map
-using Chans = std::map<int, ROCs>;
-// event id as key and channel map
-using Events = std::map<int, Chans>;
-// fed id as key and event map
-using FEDs = std::map<int, Events>;
+// a batch of pixels as columns, index i of every column is one pixel.
+// columns are read in place, adc may be null when no pixel files
+// are made. zero hit events have layer 0 and roc 0
+struct HitColumns {
+    size_t count = 0;
+    const int* event = nullptr;
+    const int* fed = nullptr;
+    const int* layer = nullptr;
+    const int* channel = nullptr;
+    const int* roc = nullptr;
+    const int* row = nullptr;
+    const int* col = nullptr;
+    const int* adc = nullptr;
+};
+
+// SRAM images of one fed, as written to the files
+struct Images {
+    // SRAMhit#.bin, one per file pair of the format
+    std::vector<std::vector<uint8_t>> hit;
+    // SRAMpix#.bin
+    std::vector<std::vector<uint8_t>> pix;
+};
 
 class Encoder {
   // Multiple Pixel Storage Class
-  // stores pixels in a nested map structure
+  // stores pixels in a flat hit store
+  // sorted by fed, event, channel, roc, row, col
  private:
   // hits per fed
   // map of total hits per fed
-  std::unordered_map<int, int> hitspFED_; // hits per fed
-  // roc highest hits per block
-  // id: block id in hits files
-  // value: if a roc in block has irregularly high hits
-  bool rocHigHitpFile_ = false;
-  // Which layer each channel is in.
-  // <channel id, layer id>
-  std::map<int, int> ChannelLayer_;
-  // store events in a hash
-  // for event counting
-  std::unordered_map<int,int> eventStore_;
-  // store events with no hits
-  // <fedid, <event id, 1 >
-  std::unordered_map<int, std::unordered_map<int, int>> zeroEvents_;
+  std::map<int, int> hitspFED_; // hits per fed
+  // hitspFED_ and totalEvents were set by setCounts()
+  bool counted_ = false;
+  // threads used by process() and build()
+  int threads_;
+  // Output flags of the run
+  int outputs_;
+  // geometry of the SRAM images
+  Format format_;
+  // statistics of the target fed from process()
+  FEDStats targetStats_;
+  int targetStatsFED_ = -1;
  public:
   // highest average fed id
-  // highest avg hit per event fed id
-  int haFEDID;
+  // highest avg hit per event fed id, or the fed given to setTarget()
+  int haFEDID = 0;
   // highest average fed hits
   // avg number of hits in above fed
   int haFEDhit;
@@ -61,31 +106,105 @@ class Encoder {
   int totalEvents;
   int totalFEDs;
   int totalZeroEvents;
+  int totalDuplicates;
   // main storage
-  FEDs storage;
+  HitStore storage;
  public:
-  Encoder() { }           // constructor
+  Encoder(int threads = 1, int outputs = OUT_ALL, const Format& format = defaultFormat())
+      : threads_(threads < 1 ? 1 : threads), outputs_(outputs), format_(format) { }  // constructor
   virtual ~Encoder() { }  // destructor
 
   // adds a pixel to class
-  int add(int event,
-          int fed,
-          int layer,
-          int ch,
-          int roc,
-          int row,
-          int col,
-          int adc);
+  // duplicates are counted when process() sorts the store
+  void add(int event,
+           int fed,
+           int layer,
+           int ch,
+           int roc,
+           int row,
+           int col,
+           int adc);
+  // adds a pixel at a slice of the store reserved with storage.resize()
+  // safe to call from several threads on separate indexes.
+  void add(size_t index,
+           int event,
+           int fed,
+           int layer,
+           int ch,
+           int roc,
+           int row,
+           int col,
+           int adc);
+  // adds a batch of pixels, large batches are split among the threads
+  // duplicates are counted when process() sorts the store
+  void add(const HitColumns& hits);
+  // hits per fed and event count from a first pass over the trees.
+  // process() uses these instead of counting the store,
+  // so the store only needs to hold the target fed
+  void setCounts(const std::map<int, int>& hitspFED, int events);
+  // hits per fed, set by process() or setCounts()
+  const std::map<int, int>& hitsPerFED() const { return hitspFED_; }
+  // Output flags given to the constructor
+  int outputs() const { return outputs_; }
+  // SRAM format given to the constructor
+  const Format& format() const { return format_; }
+  // picks the fed with the highest average hits per event
+  // sets haFEDID, haFEDhit, totalHits and totalFEDs
+  int selectFED();
 
   // process data
+  // sorts the store and removes duplicate pixels
   // gets highest hit roc and highest avg hit fed
   // populates histograms in future
   // returns number for error checking
   void process();
-  // generate binary files
-  void encode(int targetFED);
+  // makes fed the target fed: sets haFEDID, haFEDhit,
+  // hhRoc, hhChan and totalZeroEvents, and keeps its statistics
+  // process() calls it with the highest average fed
+  void setTarget(int fed);
+  // statistics of one fed in one pass, store must be sorted
+  // the fed's events are split among threads
+  FEDStats stats(int fed, int threads = 1) const;
+  // statistics of one fed, kept by process() for the target fed
+  FEDStats fedStats(int fed) const;
+  // feds with hits, in ascending order
+  std::vector<int> feds() const;
+  // SRAMhit block format of each channel of a fed,
+  // from the fed's own channel layers in stats
+  // 0: 2 rocs, 32bit   1: 4 rocs, 32bit
+  // 2: 8 rocs, 32bit   3: 8 rocs, 64bit
+  // 64-bit registers are used if stats.rocHigHit is set
+  void blockTypes(const FEDStats& stats, uint32_t* types) const;
+  // generate binary files for a fed in directory path
+  // path is empty or ends with '/'
+  // several feds can be encoded at once from different threads
+  // onlyChanged: files that already hold their image are not rewritten
+  // SRAMpix files are only written for runs with OUT_PIXELS
+  // writer: the files are written in the background until writer->wait(),
+  // without a writer encode() returns after the files are written
+  void encode(int targetFED,
+              std::string path = "",
+              std::ostream& out = std::cout,
+              bool onlyChanged = false,
+              ImageWriter* writer = nullptr) const;
+  // generate the binary file images for a fed in memory
+  // the file pairs are built on up to one thread each
+  // images are left empty if the format is not in Formats
+  void build(int targetFED, Images& images, std::ostream& out = std::cout) const;
+  // the six SRAM images of a fed in memory, process() must have run.
+  // for programs using the encoder as a library, nothing is printed
+  Images images(int targetFED) const;
   // create histogram from source data
-  void graph();
+  // formats: PlotFormat flags of the histogram_source files
+  void graph(int targetFED, std::string path = "", int formats = PLOT_PDF) const;
+  // fills size bytes of image with repeats of source
+  // an empty source fills the image with zeros
+  static void tile(uint8_t* image, size_t size, const uint8_t* source, size_t sourceSize);
+  // writes a whole image to a file with one write
+  // returns 1 on success
+  static int writeImage(std::string filename, const std::vector<uint8_t>& image);
+  // true if the file already holds the image
+  static bool sameImage(std::string filename, const std::vector<uint8_t>& image);
 };
 
 #endif
@@ -0,0 +1,97 @@
+// Event Selection
+
+#include "EventSelection.h"
+
+#include <numeric>
+#include <random>
+
+// hits per event strata of SELECT_STRATIFIED
+static const size_t STRATA = 10;
+
+int parseSelectMode(std::string name, SelectMode& mode) {
+    if (name == "first")
+        mode = SELECT_FIRST;
+    else if (name == "random")
+        mode = SELECT_RANDOM;
+    else if (name == "stratified")
+        mode = SELECT_STRATIFIED;
+    else
+        return 0;
+    return 1;
+}
+
+int EventSelection::readList(std::string filename) {
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+        return 0;
+    list_.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ids(line.substr(0, line.find('#')));
+        int id;
+        while (ids >> id)
+            list_.push_back(id);
+        if (!ids.eof())
+            return 0;
+    }
+    std::sort(list_.begin(), list_.end());
+    list_.erase(std::unique(list_.begin(), list_.end()), list_.end());
+    mode_ = SELECT_LIST;
+    return list_.empty() ? 0 : 1;
+}
+
+// count of the indexes [0, n) picked at random, sorted.
+// a partial Fisher-Yates shuffle, bounded with a modulo
+// rather than a distribution so every platform picks the same
+static std::vector<size_t> sample(size_t n, size_t count, std::mt19937_64& random) {
+    std::vector<size_t> indexes(n);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    count = std::min(count, n);
+    for (size_t i = 0; i < count; i++)
+        std::swap(indexes[i], indexes[i + random() % (n - i)]);
+    indexes.resize(count);
+    std::sort(indexes.begin(), indexes.end());
+    return indexes;
+}
+
+std::vector<int> EventSelection::select(const std::vector<int>& events,
+                                        const std::vector<uint64_t>& hits) const {
+    std::vector<int> picked;
+    size_t n = events.size();
+    if (mode_ == SELECT_LIST) {
+        std::set_intersection(events.begin(), events.end(), list_.begin(), list_.end(),
+                              std::back_inserter(picked));
+        return picked;
+    }
+    if ((mode_ == SELECT_ALL) || (count_ >= n))
+        return events;
+    std::mt19937_64 random(seed_);
+    switch (mode_) {
+        case SELECT_FIRST:
+        picked.assign(events.begin(), events.begin() + count_);
+        break;
+        case SELECT_RANDOM:
+        for (size_t i : sample(n, count_, random))
+            picked.push_back(events[i]);
+        break;
+        default: {
+            // events by hits, ties in event id order, cut into strata
+            // of equal size. Each stratum gives its share of count,
+            // so quiet and busy events keep their part of the sample
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return hits[a] < hits[b];
+            });
+            for (size_t s = 0; s < STRATA; s++) {
+                size_t begin = n * s / STRATA;
+                size_t size = n * (s + 1) / STRATA - begin;
+                size_t share = count_ * (s + 1) / STRATA - count_ * s / STRATA;
+                for (size_t i : sample(size, share, random))
+                    picked.push_back(events[order[begin + i]]);
+            }
+            std::sort(picked.begin(), picked.end());
+        }
+    }
+    return picked;
+}
@@ -0,0 +1,54 @@
+// Event Selection
+// Picks the events to encode before any pixels are read.
+// The reader first scans only _eventID, and _fedID for two
+// pass reads, then reads the entries of the selected events
+// through entry lists. The store then holds about as many
+// events as the SRAM blocks fit, whatever the input size.
+//
+// Samples are seeded and taken with a fixed generator,
+// so a seed picks the same events on every machine.
+
+#ifndef EVENTSELECTION_H
+#define EVENTSELECTION_H
+
+#include "Includes.h"
+
+enum SelectMode {
+    SELECT_ALL,         // every event
+    SELECT_FIRST,       // the lowest event ids
+    SELECT_RANDOM,      // a seeded random sample
+    SELECT_STRATIFIED,  // a seeded sample of each decile of hits per event
+    SELECT_LIST         // the event ids of a list file
+};
+
+class EventSelection {
+ private:
+  SelectMode mode_;
+  // events picked, not used for SELECT_LIST
+  size_t count_;
+  uint64_t seed_;
+  // sorted event ids of SELECT_LIST
+  std::vector<int> list_;
+ public:
+  EventSelection(SelectMode mode = SELECT_ALL, size_t count = 0, uint64_t seed = 0)
+      : mode_(mode), count_(count), seed_(seed) { }
+  virtual ~EventSelection() { }
+
+  // reads the event ids of a list file, separated by white space,
+  // # starts a comment. sets the mode to SELECT_LIST
+  // returns 1 on success, 0 if the file can't be read or has no ids
+  int readList(std::string filename);
+  SelectMode mode() const { return mode_; }
+  size_t count() const { return count_; }
+  // true if every event is read
+  bool all() const { return mode_ == SELECT_ALL; }
+  // picks events of an input
+  // events: sorted event ids, hits: hits of each event, same order
+  // returns the picked event ids, sorted
+  std::vector<int> select(const std::vector<int>& events, const std::vector<uint64_t>& hits) const;
+};
+
+// parses first, random or stratified, returns 0 for an unknown name
+int parseSelectMode(std::string name, SelectMode& mode);
+
+#endif
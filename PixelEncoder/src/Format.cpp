@@ -0,0 +1,25 @@
+// SRAM Format
+
+#include "Format.h"
+
+template <typename... F>
+static std::vector<Format> registry(FormatList<F...>) {
+    return {describe<F>()...};
+}
+
+const std::vector<Format>& formats() {
+    static const std::vector<Format> list = registry(Formats());
+    return list;
+}
+
+const Format* findFormat(const std::string& name) {
+    for (auto const& format : formats()) {
+        if (name == format.name)
+            return &format;
+    }
+    return nullptr;
+}
+
+const Format& defaultFormat() {
+    return formats().front();
+}
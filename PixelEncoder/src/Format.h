@@ -0,0 +1,77 @@
+// SRAM Format
+// Geometry of the SRAM images of a test board: the file pairs,
+// the channel blocks of each SRAMhit file, the block size and
+// the SRAMpix size. Encoding, decoding and verification all
+// take it from here.
+//
+// Each format is a FormatTraits type listed once in Formats.
+// The list gives the runtime registry, looked up by name, and
+// the encoder compiles its build kernel for every format in it.
+// A new board only needs a new type in the list.
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "Includes.h"
+
+// runtime form of a format, see FormatTraits
+struct Format {
+    const char* name;
+    // SRAMhit/SRAMpix file pairs
+    int files;
+    // channel blocks per SRAMhit file
+    int channels;
+    // bytes of each block
+    size_t blockBytes;
+    // bytes of a SRAMpix file
+    size_t pixBytes;
+
+    // the 32 bit header holds the 2 bit type of each block
+    static const size_t HEADERBYTES = 4;
+    size_t hitBytes() const { return HEADERBYTES + (size_t)channels * blockBytes; }
+    size_t pixWords() const { return pixBytes / 4; }
+    // first bit of the type of a block in the header,
+    // block 0 is the most significant
+    int headerShift(int block) const { return (channels - 1 - block) * 2; }
+};
+
+// compile time form of a format
+template <int Files, int Channels, size_t BlockBytes, size_t PixBytes>
+struct FormatTraits {
+    static_assert(Files * Channels == 48, "a fed has 48 channels");
+    static_assert(Channels <= 16, "block types must fit the 32 bit header");
+    static_assert(BlockBytes % 8 == 0, "blocks hold whole 64 bit registers");
+    static_assert(PixBytes % 4 == 0, "pixel files hold whole 32 bit words");
+    static constexpr int files = Files;
+    static constexpr int channels = Channels;
+    static constexpr size_t blockBytes = BlockBytes;
+    static constexpr size_t pixBytes = PixBytes;
+    static constexpr size_t pixWords = PixBytes / 4;
+    static constexpr size_t hitBytes = Format::HEADERBYTES + Channels * BlockBytes;
+};
+
+// GLIB board, three pairs of 8 MB SRAMs
+struct GLIBFormat : FormatTraits<3, 16, 524288, 8388608> {
+    static constexpr const char* name = "glib";
+};
+
+template <typename... F>
+struct FormatList { };
+
+// every format, the first is the default
+typedef FormatList<GLIBFormat> Formats;
+
+// runtime form of a FormatTraits type
+template <typename F>
+Format describe() {
+    return Format{F::name, F::files, F::channels, F::blockBytes, F::pixBytes};
+}
+
+// registered formats, in Formats order
+const std::vector<Format>& formats();
+// the format with a name, nullptr if there is none
+const Format* findFormat(const std::string& name);
+// the first format, used when none is given
+const Format& defaultFormat();
+
+#endif
@@ -0,0 +1,215 @@
+// Channel Histogram
+//
+// CSV: a header row "hits,1,...,48", then one row per hit count
+// PNG: 8 bit RGB, one 8x4 pixel cell per channel and hit count,
+//  channels left to right, hits from the bottom, zero is white
+//  and counts run blue to red. Written with stored deflate
+//  blocks so no compression library is needed.
+
+#include "Histogram.h"
+
+#include <mutex>
+
+void Histogram::add(int ch, size_t hits, uint64_t count) {
+    if ((ch < 1) || (ch > 48) || (count == 0))
+        return;
+    if (hits >= (size_t)rows())
+        counts_.resize((hits + 1) * 48, 0);
+    counts_[hits * 48 + ch - 1] += count;
+}
+
+void Histogram::add(int ch, const std::vector<uint64_t>& counts) {
+    for (size_t hits = 0; hits < counts.size(); hits++)
+        add(ch, hits, counts[hits]);
+}
+
+uint64_t Histogram::count(int ch, size_t hits) const {
+    if ((ch < 1) || (ch > 48) || (hits >= (size_t)rows()))
+        return 0;
+    return counts_[hits * 48 + ch - 1];
+}
+
+uint64_t Histogram::entries() const {
+    uint64_t total = 0;
+    for (uint64_t c : counts_)
+        total += c;
+    return total;
+}
+
+int Histogram::write(std::string filename, int formats, std::string label) const {
+    int status = 1;
+    if ((formats & PLOT_PDF) && (writePDF(filename + ".pdf", label) != 1))
+        status = 0;
+    if ((formats & PLOT_CSV) && (writeCSV(filename + ".csv") != 1))
+        status = 0;
+    if ((formats & PLOT_PNG) && (writePNG(filename + ".png") != 1))
+        status = 0;
+    return status;
+}
+
+int Histogram::writePDF(std::string filename, std::string label) const {
+    // ROOT graphics are not thread safe, files are drawn one at a time
+    static std::mutex drawing;
+    std::lock_guard<std::mutex> lock(drawing);
+    TCanvas* canvas = new TCanvas(("canvas" + name_).c_str());
+    TH2D* hist = new TH2D(name_.c_str(), title_.c_str(), 48, 1., 49., bins_, -0.5, bins_ - 0.5);
+    hist->SetOption("COLZ");
+    // bin (x, y) is at x + 50 * y, row 0 and bins_ + 1 are under and overflow
+    std::vector<double> content((size_t)50 * (bins_ + 2), 0.);
+    for (int hits = 0; hits < rows(); hits++) {
+        int y = std::min(hits + 1, bins_ + 1);
+        for (int ch = 1; ch < 49; ch++)
+            content[(size_t)y * 50 + ch] += counts_[(size_t)hits * 48 + ch - 1];
+    }
+    hist->SetContent(content.data());
+    hist->ResetStats();
+    hist->Draw();
+    if (label.empty())
+        canvas->Print(filename.c_str());
+    else
+        canvas->Print(filename.c_str(), label.c_str());
+    delete hist;
+    delete canvas;
+    return 1;
+}
+
+int Histogram::writeCSV(std::string filename) const {
+    std::ofstream file(filename.c_str());
+    file << "hits";
+    for (int ch = 1; ch < 49; ch++)
+        file << ',' << ch;
+    file << '\n';
+    for (int hits = 0; hits < rows(); hits++) {
+        file << hits;
+        for (int ch = 1; ch < 49; ch++)
+            file << ',' << counts_[(size_t)hits * 48 + ch - 1];
+        file << '\n';
+    }
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+static std::array<uint32_t, 256> crcTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        table[n] = c;
+    }
+    return table;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = crcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBig32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((uint8_t)(value >> shift));
+}
+
+// appends a png chunk: length, type, data, crc of type and data
+static void putChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    putBig32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBig32(out, crc32(out.data() + start, out.size() - start));
+}
+
+// palette from blue through cyan, green and yellow to red, t in [0, 1]
+static void color(double t, uint8_t* rgb) {
+    static const uint8_t stops[5][3] = {
+        {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}
+    };
+    double x = std::min(std::max(t, 0.), 1.) * 4;
+    int i = std::min((int)x, 3);
+    double f = x - i;
+    for (int c = 0; c < 3; c++)
+        rgb[c] = (uint8_t)(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f + 0.5);
+}
+
+int Histogram::writePNG(std::string filename) const {
+    const int CELLW = 8;
+    const int CELLH = 4;
+    int drawn = std::max(rows(), 1);
+    uint32_t width = 48 * CELLW;
+    uint32_t height = drawn * CELLH;
+    uint64_t highest = 0;
+    for (uint64_t c : counts_)
+        highest = std::max(highest, c);
+
+    // filter type 0 and RGB per pixel, highest hit count on top
+    size_t stride = 1 + width * 3;
+    std::vector<uint8_t> raw(stride * height, 255);
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* line = raw.data() + y * stride;
+        line[0] = 0;
+        int hits = drawn - 1 - (int)(y / CELLH);
+        for (int ch = 1; ch < 49; ch++) {
+            uint64_t c = count(ch, hits);
+            if (c == 0)
+                continue;
+            uint8_t rgb[3];
+            color((double)c / highest, rgb);
+            for (int x = 0; x < CELLW; x++)
+                std::memcpy(line + 1 + ((ch - 1) * CELLW + x) * 3, rgb, 3);
+        }
+    }
+
+    // zlib stream of stored blocks of up to 65535 bytes
+    std::vector<uint8_t> zdata = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (size_t done = 0; done < raw.size();) {
+        size_t n = std::min(raw.size() - done, (size_t)65535);
+        zdata.push_back((done + n == raw.size()) ? 1 : 0);
+        zdata.push_back(n & 0xFF);
+        zdata.push_back(n >> 8);
+        zdata.push_back(~n & 0xFF);
+        zdata.push_back((~n >> 8) & 0xFF);
+        zdata.insert(zdata.end(), raw.begin() + done, raw.begin() + done + n);
+        for (size_t i = done; i < done + n; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        done += n;
+    }
+    putBig32(zdata, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    putBig32(header, width);
+    putBig32(header, height);
+    // 8 bit depth, RGB, deflate, no filter choice, no interlace
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", zdata);
+    putChunk(png, "IEND", {});
+
+    std::ofstream file(filename.c_str(), std::ios::binary | std::ios::out);
+    file.write((const char*)png.data(), png.size());
+    file.close();
+    return file.good() ? 1 : 0;
+}
+
+int plotFormats(std::string list) {
+    int formats = 0;
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name == "pdf")
+            formats |= PLOT_PDF;
+        else if (name == "csv")
+            formats |= PLOT_CSV;
+        else if (name == "png")
+            formats |= PLOT_PNG;
+        else
+            return 0;
+    }
+    return formats;
+}
@@ -0,0 +1,54 @@
+// Channel Histogram
+// Events or registers per channel and hit count, kept in a
+// dense count matrix. The matrix is moved into a TH2D in one
+// SetContent() call, or written without ROOT as a CSV table or
+// a PNG heat map for batch nodes where starting the graphics
+// is slow.
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "Includes.h"
+
+// formats written by Histogram::write(), may be combined
+enum PlotFormat {
+    PLOT_PDF = 1,
+    PLOT_CSV = 2,
+    PLOT_PNG = 4
+};
+
+class Histogram {
+ private:
+  std::string name_;
+  std::string title_;
+  // hits 0 to bins_ - 1 are drawn, higher counts are overflow
+  int bins_;
+  // counts_[hits * 48 + channel - 1], grows with the hit counts
+  std::vector<uint64_t> counts_;
+  int rows() const { return counts_.size() / 48; }
+  int writePDF(std::string filename, std::string label) const;
+  int writeCSV(std::string filename) const;
+  int writePNG(std::string filename) const;
+ public:
+  // bins: hit count bins of the pdf histogram
+  Histogram(std::string name, std::string title, int bins)
+      : name_(name), title_(title), bins_(bins < 1 ? 1 : bins) { }
+  virtual ~Histogram() { }
+
+  // adds count to channel ch (1-48) at hits
+  void add(int ch, size_t hits, uint64_t count);
+  // adds a vector of counts indexed by hits to channel ch
+  void add(int ch, const std::vector<uint64_t>& counts);
+  uint64_t count(int ch, size_t hits) const;
+  // total of all counts
+  uint64_t entries() const;
+  // writes filename + ".pdf", ".csv" and/or ".png"
+  // label: pdf page title
+  // returns 1 if every format was written
+  int write(std::string filename, int formats, std::string label = "") const;
+};
+
+// parses a list like "pdf,csv", returns 0 for an unknown name
+int plotFormats(std::string list);
+
+#endif
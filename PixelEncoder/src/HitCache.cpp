@@ -0,0 +1,171 @@
+// Hit Cache
+//
+// Layout:
+//  CacheHeader
+//  sourceCount x {CacheSource, path padded to 8 bytes}
+//  fedCount x {int32 fed, int32 hits}
+//  hitCount x Hit
+
+#include "HitCache.h"
+#include "Instrument.h"
+#include "MappedFile.h"
+#include "Reader.h"
+
+static const char CACHE_MAGIC[8] = {'P', 'X', 'C', 'A', 'C', 'H', 'E', '\0'};
+static const uint32_t CACHE_VERSION = 5;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hitSize;
+    uint64_t hitCount;
+    // input and appended runs, and the bytes they take
+    uint32_t sourceCount;
+    uint32_t sourceBytes;
+    uint32_t fedCount;
+    int32_t events;
+    int32_t duplicates;
+    // store holds only the target fed
+    int32_t partial;
+    // Column flags the hits were read with
+    int32_t columns;
+};
+
+// a file the cache was made from
+struct CacheSource {
+    uint64_t size;
+    int64_t time;
+    uint32_t pathSize;
+    uint32_t unused;
+};
+
+// size and modification time of a file, 0 if missing
+static CacheSource stamp(const std::string& path) {
+    CacheSource source;
+    std::memset(&source, 0, sizeof(source));
+    std::error_code error;
+    source.size = std::filesystem::file_size(path, error);
+    if (error)
+        return CacheSource();
+    source.time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    if (error)
+        source.time = 0;
+    source.pathSize = path.size();
+    return source;
+}
+
+static size_t padded(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+int HitCache::read(Encoder& encoder, bool partial, size_t& appended) const {
+    ScopedTimer timer("cache.read");
+    MappedFile file(filename_);
+    if (!file.isOpen() || (file.size() < sizeof(CacheHeader)))
+        return 0;
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    // the cache must hold every column this run reads
+    int columns = Reader::columns(encoder.outputs());
+    if ((std::memcmp(header.magic, CACHE_MAGIC, 8) != 0) ||
+        (header.version != CACHE_VERSION) ||
+        (header.hitSize != sizeof(Hit)) ||
+        (header.partial && !partial) ||
+        ((header.columns & columns) != columns) ||
+        (header.sourceCount < 1) ||
+        (header.sourceCount > appended_.size() + 1))
+        return 0;
+    size_t fedBytes = (size_t)header.fedCount * 8;
+    if (file.size() != sizeof(header) + header.sourceBytes + fedBytes + header.hitCount * sizeof(Hit))
+        return 0;
+
+    // the sources must be the input and the first appended runs, unchanged
+    const uint8_t* data = file.data() + sizeof(header);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < header.sourceCount; i++) {
+        std::string path = (i == 0) ? input_ : appended_[i - 1];
+        CacheSource source, current = stamp(path);
+        if (offset + sizeof(source) > header.sourceBytes)
+            return 0;
+        std::memcpy(&source, data + offset, sizeof(source));
+        offset += sizeof(source);
+        if ((source.size != current.size) || (source.time != current.time) ||
+            (source.pathSize != path.size()) || (offset + source.pathSize > header.sourceBytes) ||
+            (std::memcmp(data + offset, path.data(), path.size()) != 0))
+            return 0;
+        offset += padded(source.pathSize);
+    }
+    data += header.sourceBytes;
+
+    encoder.storage.assign((const Hit*)(data + fedBytes), header.hitCount, header.duplicates);
+    // a partial store can not be counted again, a full one is
+    // counted by process() so appended runs are included
+    if (header.partial) {
+        std::map<int, int> hitspFED;
+        for (uint32_t i = 0; i < header.fedCount; i++) {
+            int32_t entry[2];
+            std::memcpy(entry, data + i * 8, 8);
+            hitspFED[entry[0]] = entry[1];
+        }
+        encoder.setCounts(hitspFED, header.events);
+    }
+    appended = header.sourceCount - 1;
+    timer.add(header.hitCount, file.size());
+    return 1;
+}
+
+int HitCache::write(const Encoder& encoder, bool partial) const {
+    ScopedTimer timer("cache.write");
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, 8);
+    header.version = CACHE_VERSION;
+    header.hitSize = sizeof(Hit);
+    header.hitCount = encoder.storage.size();
+    header.fedCount = encoder.hitsPerFED().size();
+    header.events = encoder.totalEvents;
+    header.duplicates = encoder.totalDuplicates;
+    header.partial = partial ? 1 : 0;
+    header.columns = Reader::columns(encoder.outputs());
+
+    std::vector<uint8_t> sources;
+    for (size_t i = 0; i <= appended_.size(); i++) {
+        std::string path = (i == 0) ? input_ : appended_[i - 1];
+        CacheSource source = stamp(path);
+        source.pathSize = path.size();
+        size_t offset = sources.size();
+        sources.resize(offset + sizeof(source) + padded(path.size()), 0);
+        std::memcpy(sources.data() + offset, &source, sizeof(source));
+        std::memcpy(sources.data() + offset + sizeof(source), path.data(), path.size());
+    }
+    header.sourceCount = appended_.size() + 1;
+    header.sourceBytes = sources.size();
+
+    std::vector<int32_t> feds;
+    for (auto const& fid : encoder.hitsPerFED()) {
+        feds.push_back(fid.first);
+        feds.push_back(fid.second);
+    }
+
+    // written under a temporary name so a cache is never half written
+    std::string temp = filename_ + ".tmp";
+    std::ofstream file(temp.c_str(), std::ios::binary | std::ios::out);
+    if (!file.is_open())
+        return 0;
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)sources.data(), sources.size());
+    file.write((const char*)feds.data(), feds.size() * 4);
+    file.write((const char*)encoder.storage.begin(), encoder.storage.size() * sizeof(Hit));
+    file.close();
+    std::error_code error;
+    if (!file.good()) {
+        std::filesystem::remove(temp, error);
+        return 0;
+    }
+    std::filesystem::rename(temp, filename_, error);
+    if (error)
+        return 0;
+    timer.add(header.hitCount, sizeof(header) + sources.size() + feds.size() * 4 +
+                               header.hitCount * sizeof(Hit));
+    return 1;
+}
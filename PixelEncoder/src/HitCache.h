@@ -0,0 +1,46 @@
+// Hit Cache
+// Binary cache of the ingested hits, kept next to the input
+// file as <input>.pxcache. It holds the sorted hit store with
+// duplicates removed and the hits per fed,
+// so later runs map it instead of reading the TTrees.
+//
+// A cache is only used if its format version and hit layout
+// match this build, it holds the columns the run needs and the
+// input file has the same size and modification time as when
+// the cache was written. The file is in host byte order.
+//
+// Runs appended to the input are listed in the cache too. A
+// cache holding the input and the first n appended runs lets
+// a run read only the remaining appended runs.
+
+#ifndef HITCACHE_H
+#define HITCACHE_H
+
+#include "Includes.h"
+#include "Encoder.h"
+
+class HitCache {
+ private:
+  std::string input_;
+  // runs appended to the input, in order
+  std::vector<std::string> appended_;
+  std::string filename_;
+ public:
+  HitCache(std::string input, std::vector<std::string> appended = {})
+      : input_(input), appended_(appended), filename_(input + ".pxcache") { }
+  virtual ~HitCache() { }
+
+  std::string filename() const { return filename_; }
+  // loads the cache into an empty encoder, process() must still be called.
+  // partial: a cache holding only the target fed of a two pass read is accepted
+  // appended: set to the number of appended runs already in the cache
+  // returns 1 on success, 0 if the cache is missing, stale or another version
+  int read(Encoder& encoder, bool partial, size_t& appended) const;
+  // writes the encoder after process(), made from the input
+  // and all appended runs
+  // partial: the store holds only the target fed
+  // returns 1 on success
+  int write(const Encoder& encoder, bool partial) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+// Hit Store
+// Flat storage for pixel hits.
+
+#include "HitStore.h"
+
+// sort keys
+// major: fed, event (event is offset so negative ids sort first)
+// minor: channel, roc, row, col
+static inline uint64_t majorKey(const Hit& h) {
+    return ((uint64_t)h.fed << 32) | (uint32_t)((uint32_t)h.event ^ 0x80000000u);
+}
+
+static inline uint32_t minorKey(const Hit& h) {
+    return ((uint32_t)h.ch << 24) | ((uint32_t)h.roc << 16) |
+           ((uint32_t)h.row << 8) | (uint32_t)h.col;
+}
+
+void HitStore::add(int event, int fed, int layer, int ch, int roc, int row, int col, int adc) {
+    hits_.emplace_back();
+    set(hits_.size() - 1, event, fed, layer, ch, roc, row, col, adc);
+}
+
+void HitStore::addZero(int event, int fed) {
+    add(event, fed, 0, 0, 0, 0, 0, 0);
+}
+
+void HitStore::set(size_t index, int event, int fed, int layer, int ch, int roc, int row, int col, int adc) {
+    Hit& hit = hits_[index];
+    hit.event = event;
+    hit.fed = (uint16_t)fed;
+    hit.layer = (uint8_t)layer;
+    hit.ch = (uint8_t)ch;
+    hit.roc = (uint8_t)roc;
+    hit.row = (uint8_t)row;
+    hit.col = (uint8_t)col;
+    hit.adc = (uint8_t)adc;
+}
+
+void HitStore::setZero(size_t index, int event, int fed) {
+    set(index, event, fed, 0, 0, 0, 0, 0, 0);
+}
+
+void HitStore::assign(const Hit* hits, size_t count, int duplicates) {
+    hits_.assign(hits, hits + count);
+    duplicates_ = duplicates;
+    sorted_ = count;
+}
+
+void HitStore::sort() {
+    if (sorted_ == hits_.size())
+        return;
+    auto less = [](const Hit& a, const Hit& b) {
+        uint64_t ma = majorKey(a), mb = majorKey(b);
+        if (ma != mb)
+            return ma < mb;
+        return minorKey(a) < minorKey(b);
+    };
+    // stable so the first stored copy of a duplicate pixel is kept,
+    // the merge puts hits sorted earlier before equal new ones
+    std::stable_sort(hits_.begin() + sorted_, hits_.end(), less);
+    std::inplace_merge(hits_.begin(), hits_.begin() + sorted_, hits_.end(), less);
+    // drop duplicates in place
+    // repeated zero markers are not counted as duplicate pixels
+    size_t out = 0;
+    for (size_t i = 0; i < hits_.size(); i++) {
+        if (out > 0 && majorKey(hits_[i]) == majorKey(hits_[out - 1]) &&
+            minorKey(hits_[i]) == minorKey(hits_[out - 1])) {
+            if (hits_[i].ch != 0)
+                duplicates_++;
+            continue;
+        }
+        hits_[out++] = hits_[i];
+    }
+    hits_.resize(out);
+    sorted_ = out;
+}
+
+std::pair<const Hit*, const Hit*> HitStore::fed(int fed) const {
+    auto first = std::lower_bound(begin(), end(), fed, [](const Hit& h, int f) {
+        return h.fed < f;
+    });
+    auto last = std::upper_bound(first, end(), fed, [](int f, const Hit& h) {
+        return f < h.fed;
+    });
+    return std::make_pair(first, last);
+}
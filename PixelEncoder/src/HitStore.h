@@ -0,0 +1,111 @@
+// Hit Store
+// Flat storage for pixel hits.
+// Hits are appended unsorted while the TTrees are read,
+// then sorted once by fed, event, channel, roc, row, col.
+// Duplicate pixels are dropped during that sort.
+// Hits appended after a sort are sorted on their own and
+// merged into the sorted part, so adding a small run to a
+// large store does not sort the whole store again.
+
+#ifndef HITSTORE_H
+#define HITSTORE_H
+
+#include "Includes.h"
+
+// one stored pixel
+// an event with zero hits is stored as a marker
+// with channel 0 and roc 0, which sorts first in its event.
+// The layer is kept per pixel, so the channel layers of
+// each fed are known from its own hits.
+struct Hit {
+    int32_t event;
+    uint16_t fed;
+    uint8_t ch;
+    uint8_t roc;
+    uint8_t row;
+    uint8_t col;
+    uint8_t adc;
+    // layer of the channel, 0 for zero hit markers
+    uint8_t layer;
+};
+
+// allocator that leaves new elements uninitialized,
+// so growing the store with resize() does not write every
+// hit before the reader threads fill their slices
+template <typename T>
+struct UninitializedAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        typedef UninitializedAllocator<U> other;
+    };
+    UninitializedAllocator() = default;
+    template <typename U>
+    UninitializedAllocator(const UninitializedAllocator<U>&) { }
+    template <typename U>
+    void construct(U* p) { ::new ((void*)p) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new ((void*)p) U(std::forward<Args>(args)...); }
+};
+
+class HitStore {
+ private:
+  std::vector<Hit, UninitializedAllocator<Hit>> hits_;
+  // hits_[0, sorted_) are sorted and free of duplicates
+  size_t sorted_ = 0;
+  // duplicate pixels removed by sort()
+  int duplicates_ = 0;
+ public:
+  HitStore() { }
+  virtual ~HitStore() { }
+
+  void reserve(size_t count) { hits_.reserve(count); }
+  // grows the store so slices of it can be filled
+  // by set() from several threads. New hits are
+  // uninitialized until set.
+  void resize(size_t count) { hits_.resize(count); sorted_ = std::min(sorted_, count); }
+  // appends a pixel, duplicates are kept until sort()
+  void add(int event, int fed, int layer, int ch, int roc, int row, int col, int adc);
+  // appends a zero hit marker for an event
+  void addZero(int event, int fed);
+  // stores a pixel or zero hit marker at an index made by resize(),
+  // past the hits sorted so far
+  void set(size_t index, int event, int fed, int layer, int ch, int roc, int row, int col, int adc);
+  void setZero(size_t index, int event, int fed);
+  // replaces the store with hits that are already sorted
+  // and free of duplicates, such as a cached store
+  void assign(const Hit* hits, size_t count, int duplicates);
+  // sorts hits and removes duplicate pixels
+  // of hits stored twice the first stored copy is kept
+  void sort();
+  int duplicates() const { return duplicates_; }
+
+  // hits of one fed, store must be sorted
+  std::pair<const Hit*, const Hit*> fed(int fed) const;
+  const Hit* begin() const { return hits_.data(); }
+  const Hit* end() const { return hits_.data() + hits_.size(); }
+  size_t size() const { return hits_.size(); }
+};
+
+// walks the hits of one fed event by event.
+// [first, last) must be sorted; f is called with the event id,
+// whether the event is marked as having zero hits,
+// and the event's pixels sorted by channel, roc, row, col.
+// if f returns bool, returning false stops the walk
+template <typename F>
+void forEachEvent(const Hit* first, const Hit* last, F f) {
+    while (first != last) {
+        const Hit* end = first;
+        while (end != last && end->event == first->event)
+            end++;
+        bool zero = (first->ch == 0);
+        if constexpr (std::is_same<decltype(f(0, false, first, last)), bool>::value) {
+            if (!f(first->event, zero, zero ? first + 1 : first, end))
+                return;
+        } else {
+            f(first->event, zero, zero ? first + 1 : first, end);
+        }
+        first = end;
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+// Image Writer
+
+#include "ImageWriter.h"
+#include "Instrument.h"
+
+#include <fcntl.h>
+#include <set>
+#include <unistd.h>
+
+// writes what is left of a job after offset with plain writes
+static bool writeRest(int fd, const std::vector<uint8_t>& image, size_t offset) {
+    while (offset < image.size()) {
+        ssize_t n = pwrite(fd, image.data() + offset, image.size() - offset, offset);
+        if (n <= 0)
+            return false;
+        offset += n;
+    }
+    return true;
+}
+
+ssize_t ImageWriter::finish(aiocb& request) {
+    const aiocb* list[1] = {&request};
+    while (aio_error(&request) == EINPROGRESS)
+        aio_suspend(list, 1, nullptr);
+    return aio_return(&request);
+}
+
+void ImageWriter::submit(std::string filename, std::vector<uint8_t> image) {
+    ScopedTimer timer("write.submit");
+    timer.add(1, image.size());
+    std::unique_ptr<Job> job(new Job());
+    job->filename = filename;
+    job->temp = filename + ".tmp";
+    job->image = std::move(image);
+    job->fd = ::open(job->temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (job->fd < 0) {
+        job->failed = true;
+    } else {
+        std::memset(&job->request, 0, sizeof(job->request));
+        job->request.aio_fildes = job->fd;
+        job->request.aio_buf = job->image.data();
+        job->request.aio_nbytes = job->image.size();
+        job->request.aio_offset = 0;
+        job->request.aio_sigevent.sigev_notify = SIGEV_NONE;
+        if (aio_write(&job->request) == 0)
+            job->queued = true;
+        else
+            job->failed = !writeRest(job->fd, job->image, 0);
+    }
+    jobs_.push_back(std::move(job));
+}
+
+int ImageWriter::wait(std::ostream& out) {
+    if (jobs_.empty())
+        return 0;
+    ScopedTimer timer("write.wait");
+    // finish the writes, then sync all files at once
+    for (auto& job : jobs_) {
+        if (!job->queued)
+            continue;
+        ssize_t n = finish(job->request);
+        job->queued = false;
+        if ((n < 0) || !writeRest(job->fd, job->image, n))
+            job->failed = true;
+    }
+    for (auto& job : jobs_) {
+        if (job->failed || (job->fd < 0))
+            continue;
+        std::memset(&job->request, 0, sizeof(job->request));
+        job->request.aio_fildes = job->fd;
+        job->request.aio_sigevent.sigev_notify = SIGEV_NONE;
+        job->queued = (aio_fsync(O_SYNC, &job->request) == 0);
+        if (!job->queued && (fsync(job->fd) != 0))
+            job->failed = true;
+    }
+    int failures = 0;
+    // directories holding renamed files
+    std::set<std::string> dirs;
+    for (auto& job : jobs_) {
+        if (job->queued && (finish(job->request) != 0))
+            job->failed = true;
+        if ((job->fd >= 0) && (::close(job->fd) != 0))
+            job->failed = true;
+        if (!job->failed && (std::rename(job->temp.c_str(), job->filename.c_str()) != 0))
+            job->failed = true;
+        if (job->failed) {
+            std::remove(job->temp.c_str());
+            out << "Error: Couldn't write " << job->filename << '\n';
+            failures++;
+        } else {
+            timer.add(1, job->image.size());
+            std::string dir = std::filesystem::path(job->filename).parent_path().string();
+            dirs.insert(dir.empty() ? "." : dir);
+        }
+    }
+    // the renames are only durable once their directories are synced
+    for (auto const& dir : dirs) {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        bool synced = (fd >= 0) && (fsync(fd) == 0);
+        if ((fd >= 0) && (::close(fd) != 0))
+            synced = false;
+        if (!synced) {
+            out << "Error: Couldn't sync " << dir << '\n';
+            failures++;
+        }
+    }
+    jobs_.clear();
+    return failures;
+}
@@ -0,0 +1,45 @@
+// Image Writer
+// Writes SRAM images with POSIX asynchronous I/O while the
+// caller goes on, such as drawing histograms. Every image is
+// written to a temporary file, synced and renamed into place,
+// so a file always holds either its old or its new image. The
+// directories are synced after the renames.
+
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include "Includes.h"
+
+#include <aio.h>
+#include <memory>
+
+class ImageWriter {
+ private:
+  // one image being written
+  struct Job {
+      std::string filename;
+      std::string temp;
+      std::vector<uint8_t> image;
+      int fd = -1;
+      aiocb request;
+      // the write was queued, otherwise it failed or was done in submit()
+      bool queued = false;
+      bool failed = false;
+  };
+  std::vector<std::unique_ptr<Job>> jobs_;
+  // waits for one queued request, returns its result
+  static ssize_t finish(aiocb& request);
+ public:
+  ImageWriter() { }
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+  virtual ~ImageWriter() { wait(); }
+
+  // starts writing image to filename, the writer keeps the image
+  void submit(std::string filename, std::vector<uint8_t> image);
+  // finishes all writes, syncs and renames the files
+  // prints failed files to out, returns the number of failures
+  int wait(std::ostream& out = std::cout);
+};
+
+#endif
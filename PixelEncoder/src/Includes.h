@@ -4,15 +4,23 @@
 #define INCLUDES_H
 
 #include <time.h>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <iostream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <array>
+#include <thread>
 
 #include <TCanvas.h>
+#include <TEntryList.h>
 #include <TFile.h>
 #include <TH2.h>
 #include <TH2D.h>
@@ -0,0 +1,157 @@
+// Run Instrumentation
+
+#include "Instrument.h"
+
+#include <sys/resource.h>
+
+#ifndef PIXEL_VERSION
+#define PIXEL_VERSION "unknown"
+#endif
+
+std::mutex Instrument::mutex_;
+std::vector<std::pair<std::string, PhaseStats>> Instrument::phases_;
+std::vector<std::pair<std::string, long long>> Instrument::stats_;
+std::vector<std::pair<std::string, std::string>> Instrument::info_;
+std::chrono::steady_clock::time_point Instrument::start_ = std::chrono::steady_clock::now();
+std::atomic<long long> Instrument::allocations(0);
+std::atomic<long long> Instrument::allocatedBytes(0);
+
+// text as a quoted JSON string
+static std::string quote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if ((c == '"') || (c == '\\'))
+            quoted += '\\';
+        if ((unsigned char)c >= 0x20)
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+PhaseStats& Instrument::phase(const std::string& name) {
+    for (auto& p : phases_) {
+        if (p.first == name)
+            return p.second;
+    }
+    phases_.emplace_back(name, PhaseStats());
+    return phases_.back().second;
+}
+
+void Instrument::record(const std::string& name, const PhaseStats& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PhaseStats& p = phase(name);
+    p.calls += stats.calls;
+    p.wall += stats.wall;
+    p.cpu += stats.cpu;
+    p.items += stats.items;
+    p.bytes += stats.bytes;
+    p.allocations += stats.allocations;
+    p.allocatedBytes += stats.allocatedBytes;
+}
+
+void Instrument::count(const std::string& name, long long items, long long bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PhaseStats& p = phase(name);
+    p.items += items;
+    p.bytes += bytes;
+}
+
+void Instrument::stat(const std::string& name, long long value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& s : stats_) {
+        if (s.first == name) {
+            s.second = value;
+            return;
+        }
+    }
+    stats_.emplace_back(name, value);
+}
+
+void Instrument::info(const std::string& name, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& i : info_) {
+        if (i.first == name) {
+            i.second = value;
+            return;
+        }
+    }
+    info_.emplace_back(name, value);
+}
+
+double Instrument::threadCPU() {
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+long Instrument::peakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void Instrument::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_.clear();
+    stats_.clear();
+    info_.clear();
+    start_ = std::chrono::steady_clock::now();
+}
+
+void Instrument::writeJSON(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(6);
+    out << "{\n"
+        << "  \"version\": " << quote(PIXEL_VERSION) << ",\n";
+    for (auto const& i : info_)
+        out << "  " << quote(i.first) << ": " << quote(i.second) << ",\n";
+    out << "  \"wall_s\": " << wall << ",\n"
+        << "  \"cpu_s\": " << ((double)clock() / CLOCKS_PER_SEC) << ",\n"
+        << "  \"peak_rss_kb\": " << peakRSS() << ",\n"
+        << "  \"allocations\": " << allocations.load() << ",\n"
+        << "  \"allocated_bytes\": " << allocatedBytes.load() << ",\n"
+        << "  \"stats\": {";
+    for (size_t i = 0; i < stats_.size(); i++) {
+        out << ((i == 0) ? "\n" : ",\n")
+            << "    " << quote(stats_[i].first) << ": " << stats_[i].second;
+    }
+    out << (stats_.empty() ? "},\n" : "\n  },\n")
+        << "  \"phases\": [";
+    for (size_t i = 0; i < phases_.size(); i++) {
+        const PhaseStats& p = phases_[i].second;
+        out << ((i == 0) ? "\n" : ",\n")
+            << "    {\"name\": " << quote(phases_[i].first)
+            << ", \"calls\": " << p.calls
+            << ", \"wall_s\": " << p.wall
+            << ", \"cpu_s\": " << p.cpu
+            << ", \"items\": " << p.items
+            << ", \"items_per_s\": " << ((p.wall > 0.0) ? p.items / p.wall : 0.0)
+            << ", \"bytes\": " << p.bytes
+            << ", \"mb_per_s\": " << ((p.wall > 0.0) ? p.bytes / 1048576.0 / p.wall : 0.0)
+            << ", \"allocations\": " << p.allocations
+            << ", \"allocated_bytes\": " << p.allocatedBytes << "}";
+    }
+    out << (phases_.empty() ? "]\n" : "\n  ]\n") << "}\n";
+    out.flags(flags);
+}
+
+ScopedTimer::ScopedTimer(std::string name)
+    : name_(name),
+      wall_(std::chrono::steady_clock::now()),
+      cpu_(Instrument::threadCPU()),
+      allocations_(Instrument::allocations.load(std::memory_order_relaxed)),
+      allocatedBytes_(Instrument::allocatedBytes.load(std::memory_order_relaxed)) { }
+
+ScopedTimer::~ScopedTimer() {
+    PhaseStats stats;
+    stats.calls = 1;
+    stats.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_).count();
+    stats.cpu = Instrument::threadCPU() - cpu_;
+    stats.items = items_;
+    stats.bytes = bytes_;
+    stats.allocations = Instrument::allocations.load(std::memory_order_relaxed) - allocations_;
+    stats.allocatedBytes = Instrument::allocatedBytes.load(std::memory_order_relaxed) - allocatedBytes_;
+    Instrument::record(name_, stats);
+}
@@ -0,0 +1,112 @@
+// Run Instrumentation
+// Scoped timers and counters for the phases of a run,
+// collected into one report that is written as JSON.
+//
+// Timers record wall time and the cpu time of the calling
+// thread, so timers on worker threads add up to the cpu
+// time of a parallel phase. Heap allocations are counted
+// for the whole process by the global operator new in
+// Allocations.cpp, which is not part of the library.
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include "Includes.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// totals of one named phase or counter
+struct PhaseStats {
+    long long calls = 0;
+    double wall = 0.0;
+    double cpu = 0.0;
+    long long items = 0;
+    long long bytes = 0;
+    long long allocations = 0;
+    long long allocatedBytes = 0;
+};
+
+class Instrument {
+ private:
+  static std::mutex mutex_;
+  // phases in the order they were first recorded
+  static std::vector<std::pair<std::string, PhaseStats>> phases_;
+  static std::vector<std::pair<std::string, long long>> stats_;
+  static std::vector<std::pair<std::string, std::string>> info_;
+  static std::chrono::steady_clock::time_point start_;
+  static PhaseStats& phase(const std::string& name);
+ public:
+  // heap allocations since the start of the process
+  static std::atomic<long long> allocations;
+  static std::atomic<long long> allocatedBytes;
+
+  // adds one call of a phase
+  static void record(const std::string& name, const PhaseStats& stats);
+  // adds items and bytes to a phase without timing it
+  static void count(const std::string& name, long long items, long long bytes = 0);
+  // sets a run statistic, shown in the report as name: value
+  static void stat(const std::string& name, long long value);
+  // sets a text field of the report, such as the input file
+  static void info(const std::string& name, const std::string& value);
+  // cpu time of the calling thread in seconds
+  static double threadCPU();
+  // peak resident memory of the process in kB
+  static long peakRSS();
+  // writes the run report
+  static void writeJSON(std::ostream& out);
+  // clears all phases and statistics
+  static void reset();
+};
+
+// times the enclosing scope as one call of a phase
+class ScopedTimer {
+ private:
+  std::string name_;
+  std::chrono::steady_clock::time_point wall_;
+  double cpu_;
+  long long allocations_;
+  long long allocatedBytes_;
+  long long items_ = 0;
+  long long bytes_ = 0;
+ public:
+  ScopedTimer(std::string name);
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  virtual ~ScopedTimer();
+
+  // items and bytes handled in the scope
+  void add(long long items, long long bytes = 0) {
+      items_ += items;
+      bytes_ += bytes;
+  }
+};
+
+// accumulates time over many short intervals of one thread,
+// recorded as one call of a phase
+class Stopwatch {
+ private:
+  std::chrono::steady_clock::time_point wall_;
+  double cpu_ = 0.0;
+  PhaseStats stats_;
+ public:
+  void start() {
+      wall_ = std::chrono::steady_clock::now();
+      cpu_ = Instrument::threadCPU();
+  }
+  void stop() {
+      stats_.wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_).count();
+      stats_.cpu += Instrument::threadCPU() - cpu_;
+  }
+  void add(long long items, long long bytes = 0) {
+      stats_.items += items;
+      stats_.bytes += bytes;
+  }
+  void record(const std::string& name) {
+      stats_.calls = 1;
+      Instrument::record(name, stats_);
+  }
+};
+
+#endif
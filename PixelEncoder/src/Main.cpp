@@ -1,110 +1,566 @@
+#include "Analytics.h"
 #include "Encoder.h"
 #include "Decoder.h"
+#include "EventSelection.h"
+#include "HitCache.h"
+#include "Instrument.h"
+#include "Reader.h"
+#include "Tasks.h"
+#include "Verifier.h"
 
-int main(int argc, char* argv[]) {
-    // clock to record process time
-    clock_t t1, t2, st1, st2, et1, et2;
+// settings of a run, the same for every input of a manifest
+struct Options {
+    // threads used to read the TTrees
+    int threads = 1;
+    // only store pixels of the target fed
+    bool twoPass = false;
+    // encode every fed, or the feds in fedList
+    bool allFEDs = false;
+    std::vector<int> fedList;
+    // load and save the ingested hits in <filename>.pxcache
+    bool useCache = false;
+    // runs added to the input, in order
+    std::vector<std::string> appendFiles;
+    // files and histograms made, the reader skips columns they don't use
+    int outputs = OUT_ALL;
+    // PlotFormat flags of the histograms
+    int plots = PLOT_PDF;
+    // geometry of the SRAM images
+    const Format* format = &defaultFormat();
+    // write the occupancy tables of every fed
+    bool analytics = false;
+    // how the target fed is picked
+    Target target;
+    // events read from the input
+    EventSelection selection;
+    // the arguments that change the outputs, in order,
+    // kept in the stamp of a finished manifest input
+    std::string outputArgs;
+};
 
-    if (argc != 2) {  // if no arguments
-        std::cout << "usage: " << argv[0] << " <filename>\n";
-        return 1;
-    }
+// written to an output directory after its input finished
+static const char* STAMP = "PixelEncoder.done";
 
-    TFile* file = new TFile(argv[1]);
-    // check if file loaded correctly
-    if (!(file->IsOpen())) {
-        std::cout << "Couln't open " << argv[1] << "\n";
-        return 1;
+// output directory of a fed in all feds mode
+static std::string fedPath(std::string outDir, int fed) {
+    return outDir + "FED" + std::to_string(fed) + "/";
+}
+
+// decodes the hit files in path and draws the binary histogram,
+// then compares the hit and pixel files and the decoded hit
+// counts with the source data
+// returns 1 if the files match, 0 otherwise
+static int verify(const Encoder& encoder, int fed, std::string path, const Options& options,
+                  std::ostream& out) {
+    Decoder decoder(fed, encoder.fedStats(fed).histogramBins(), encoder.format());
+
+    out<<"\nChecking binary files.\n";
+    decoder.decode(path, options.threads, out);
+    out << "Done checking binary files.\n";
+
+    if (options.outputs & OUT_GRAPHS) {
+        out << "\nGenerating histogram from binary data.\n";
+        decoder.graph(path, options.plots);
+        out << "Done generating histgram from binary data.\n";
     }
 
-    t1 = clock();
-    std::cout << "Program start.\n";
+    out << "\nComparing binary files with source data.\n";
+    Verifier verifier(encoder, fed, path);
+    int mismatches = verifier.verify(out, &decoder);
+    if (mismatches == 0)
+        out << "Binary files match source data.";
+    else if (mismatches > 0)
+        out << "Error: " << mismatches << " mismatches with source data.";
+    return (mismatches == 0) ? 1 : 0;
+}
 
-    // decode data from TTree
-    TTreeReader readerH("HighFedData", file);
-    TTreeReaderValue<int> event(readerH, "Data._eventID");
-    TTreeReaderValue<int> fed(readerH, "Data._fedID");
-    TTreeReaderValue<int> layer(readerH, "Data._layer");
-    TTreeReaderValue<int> chan(readerH, "Data._channel");
-    TTreeReaderValue<int> roc(readerH, "Data._ROC");
-    TTreeReaderValue<int> row(readerH, "Data._row");
-    TTreeReaderValue<int> col(readerH, "Data._col");
-    TTreeReaderValue<int> adc(readerH, "Data._adc");
+// true if the last run to outDir finished with the same
+// arguments and every file it writes exists and is newer
+// than the input and appended runs
+static bool upToDate(const Options& options, std::string filename, std::string outDir) {
+    // feds with hits are only known after reading
+    if (options.allFEDs)
+        return false;
+    std::ifstream stamp((outDir + STAMP).c_str());
+    std::string args;
+    if (!std::getline(stamp, args) || (args != options.outputArgs))
+        return false;
+    std::vector<std::string> dirs;
+    if (options.fedList.empty()) {
+        dirs.push_back(outDir);
+    } else {
+        for (int fed : options.fedList)
+            dirs.push_back(fedPath(outDir, fed));
+    }
+    std::vector<std::string> names;
+    std::vector<std::string> files = {outDir + STAMP};
+    if (options.analytics) {
+        for (const char* table : {"feds", "channels", "rocs", "events", "hits"})
+            files.push_back(outDir + "analytics_" + table + ".csv");
+    }
+    for (int filenum = 0; filenum < options.format->files; filenum++) {
+        if (options.outputs & OUT_HITS)
+            names.push_back("SRAMhit" + std::to_string(filenum) + ".bin");
+        if (options.outputs & OUT_PIXELS)
+            names.push_back("SRAMpix" + std::to_string(filenum) + ".bin");
+    }
+    if ((options.outputs & OUT_HITS) && (options.outputs & OUT_GRAPHS)) {
+        // in PlotFormat bit order
+        const char* extensions[3] = {".pdf", ".csv", ".png"};
+        for (int f = 0; f < 3; f++) {
+            if (options.plots & (1 << f)) {
+                names.push_back(std::string("histogram_source") + extensions[f]);
+                names.push_back(std::string("histogram_binary") + extensions[f]);
+            }
+        }
+    }
+    for (auto const& dir : dirs) {
+        for (auto const& name : names)
+            files.push_back(dir + name);
+    }
+    std::error_code error;
+    auto newest = std::filesystem::last_write_time(filename, error);
+    if (error)
+        return false;
+    for (auto const& appendFile : options.appendFiles) {
+        auto time = std::filesystem::last_write_time(appendFile, error);
+        if (error)
+            return false;
+        newest = std::max(newest, time);
+    }
+    for (auto const& file : files) {
+        auto time = std::filesystem::last_write_time(file, error);
+        if (error || (time < newest))
+            return false;
+    }
+    return true;
+}
 
-    TTreeReader readerZ("ZeroData", file);
-    TTreeReaderValue<int> event0(readerZ, "Data._eventID");
-    TTreeReaderValue<int> fed0(readerZ, "Data._fedID");
-    TTreeReaderValue<int> layer0(readerZ, "Data._layer");
+// reads, encodes and checks one input, outDir is empty or ends with '/'
+// record: the statistics go to the run report
+// returns 1 on success, 0 if an input could not be read
+// or the binary files don't match it
+static int runFile(const Options& options, std::string filename, std::string outDir,
+                   std::ostream& out, bool record) {
+    clock_t st1, st2, et1, et2;
+    bool multiFED = options.allFEDs || !options.fedList.empty();
+    bool incremental = !options.appendFiles.empty();
+    const std::vector<std::string>& appendFiles = options.appendFiles;
+    int threads = options.threads;
 
-    Encoder encoder;
+    Encoder encoder(threads, options.outputs, *options.format);
+    Reader reader(filename, threads, options.outputs);
+    reader.setSelection(&options.selection);
+    HitCache cache(filename, appendFiles);
 
     st1 = clock();
-    std::cout << "\nStoring pixels...\n";
-    // stores duplicate pixel amount
-    int duplicates = 0;
-    // loop through TTree and store data in the encoder
-    while (readerH.Next()) {
-        duplicates += encoder.add(*event, *fed, *layer, *chan, *roc, *row, *col, *adc);
+    out << "\nStoring pixels...\n";
+    // a cache made from the same input replaces reading the TTrees,
+    // appended runs it already holds are not read again
+    size_t appended = 0;
+    bool cached = options.useCache && (cache.read(encoder, options.twoPass, appended) == 1);
+    if (cached) {
+        out << "Loaded " << cache.filename() << "\n";
+    } else {
+        // loop through TTrees and store data in the encoder
+        int status = options.twoPass ? reader.readTarget(encoder) : reader.read(encoder);
+        if (status != 1) {
+            out << "Couln't read " << filename << "\n";
+            return 0;
+        }
     }
-    while (readerZ.Next()) {
-        duplicates += encoder.add(*event0, *fed0, *layer0, 0, 0, 0, 0, 0);
+    if (!options.selection.all())
+        out << "Selected " << reader.selectedEvents() << " of " << reader.scannedEvents() << " events.\n";
+    for (size_t i = appended; i < appendFiles.size(); i++) {
+        out << "Appending " << appendFiles[i] << "\n";
+        Reader appendReader(appendFiles[i], threads, options.outputs);
+        if (appendReader.read(encoder) != 1) {
+            out << "Couln't read " << appendFiles[i] << "\n";
+            return 0;
+        }
     }
 
     st2 = clock();
-    std::cout << "Done storing pixels. Store time of "
-              << (((float)st2 - (float)st1) / CLOCKS_PER_SEC)
-              << " seconds.\n\nProcessing Pixels...\n";
+    out << "Done storing pixels. Store time of "
+        << (((float)st2 - (float)st1) / CLOCKS_PER_SEC)
+        << " seconds.\n\nProcessing Pixels...\n";
 
     // process stored data
+    // duplicates are removed here
     encoder.process();
+    bool changed = !cached || (appended < appendFiles.size());
+    if (options.useCache && changed && (cache.write(encoder, options.twoPass) != 1))
+        out << "Error: Couldn't write " << cache.filename() << "\n";
+
+    // summaries of every fed from the store, the input is not read again
+    Analytics analytics(encoder);
+    bool targeted = (options.target.policy != TARGET_AVERAGE);
+    if (options.analytics || targeted) {
+        out << "Analyzing " << encoder.feds().size() << " FEDs.\n";
+        analytics.run(threads);
+        int target = analytics.select(options.target);
+        if (targeted && (target != -1))
+            encoder.setTarget(target);
+    }
+    std::string targetLabel = targeted ? "Target FED Id (" + targetName(options.target) + "): "
+                                       : "Highest Avg Hit FED Id: ";
 
     // output is stored in a string to print both to a file and terminal
     std::string output;
-    output = "Total duplicate pixels: " + std::to_string(duplicates) +
+    output = "Total duplicate pixels: " + std::to_string(encoder.totalDuplicates) +
              "\nTotal events: " + std::to_string(encoder.totalEvents) +
              "\nTotal events with zero hits: " + std::to_string(encoder.totalZeroEvents) +
              "\nTotal hits: " + std::to_string(encoder.totalHits) +
              "\nTotal FEDs: " + std::to_string(encoder.totalFEDs) +
              "\nHighest hits in a roc: " + std::to_string(encoder.hhRoc) +
              "\nHighest hits in a channel: " +std::to_string(encoder.hhChan) +
-             "\n\nHighest Avg Hit FED Id: " + std::to_string(encoder.haFEDID) +
+             "\n\n" + targetLabel + std::to_string(encoder.haFEDID) +
              "\nWith an avg hit count of: " + std::to_string(encoder.haFEDhit);
 
-    et1 = clock();
-    std::cout << "\n\nEncoding binary files...\n\n";
-    encoder.encode(encoder.haFEDID);
-    et2 = clock();
-    std::cout << "\nDone encoding with an encoding time of "
-              << (((float)et2 - (float)et1) / CLOCKS_PER_SEC)
-              << " seconds.\n\nGenerating histogram from source data.\n";
-    encoder.graph();
-    std::cout << "\nDone generating histogram from source data.\n";
-    file->Close();
-
-    // print to terminal
-    std::cout << output;
-
-    // output process time in seconds
-    
-    Decoder decoder;
-
-    std::cout<<"\nChecking binary files.\n";
-    if (decoder.open("SRAMhit0.bin", 1) != 1)
-        std::cout<<"Error: Missing SRAMhit0.bin in directory.\n";
-    if (decoder.open("SRAMhit1.bin", 17) != 1)
-        std::cout<<"Error: Missing SRAMhit1.bin in directory.\n";
-    if (decoder.open("SRAMhit2.bin", 33) != 1)
-        std::cout<<"Error: Missing SRAMhit2.bin in directory.\n";
-
-    std::cout << "Done checking binary files.\n\nGenerating histogram from binary data.\n";
-
-    decoder.graph();
-    std::cout << "Done generating histgram from binary data.";
+    if (record) {
+        Instrument::info("input", filename);
+        Instrument::stat("threads", threads);
+        if (!options.selection.all()) {
+            Instrument::stat("scanned_events", reader.scannedEvents());
+            Instrument::stat("selected_events", reader.selectedEvents());
+        }
+        Instrument::stat("duplicates", encoder.totalDuplicates);
+        Instrument::stat("events", encoder.totalEvents);
+        Instrument::stat("zero_events", encoder.totalZeroEvents);
+        Instrument::stat("hits", encoder.totalHits);
+        Instrument::stat("feds", encoder.totalFEDs);
+        Instrument::stat("highest_roc_hits", encoder.hhRoc);
+        Instrument::stat("highest_channel_hits", encoder.hhChan);
+        Instrument::info("target_policy", targetName(options.target));
+        Instrument::stat("target_fed", encoder.haFEDID);
+        Instrument::stat("target_fed_avg_hits", encoder.haFEDhit);
+    }
+
+    if (!outDir.empty())
+        std::filesystem::create_directories(outDir);
+    if (options.analytics && (analytics.write(outDir) != 1))
+        out << "Error: Couldn't write the analytics tables to " << (outDir.empty() ? "./" : outDir) << "\n";
+
+    int status = 1;
+    if (!(options.outputs & OUT_HITS)) {
+        out << "\n" << output;
+    } else if (multiFED) {
+        // encode each fed into its own directory on the worker threads,
+        // histograms and checks use ROOT graphics and run after
+        std::vector<int> feds;
+        std::vector<int> stored = encoder.feds();
+        for (int fed : (options.allFEDs ? stored : options.fedList)) {
+            if (std::binary_search(stored.begin(), stored.end(), fed)) {
+                feds.push_back(fed);
+                std::filesystem::create_directories(fedPath(outDir, fed));
+            } else {
+                out << "FED " << fed << " has no hits, skipped.\n";
+            }
+        }
+        et1 = clock();
+        out << "\n\nEncoding binary files for " << feds.size() << " FEDs...\n\n";
+        std::vector<std::string> logs(feds.size());
+        // each build uses up to three threads
+        runTasks(feds.size(), std::max(1, threads / 3), [&](size_t t) {
+            std::ostringstream log;
+            encoder.encode(feds[t], fedPath(outDir, feds[t]), log, incremental);
+            logs[t] = log.str();
+        });
+        et2 = clock();
+        out << "Done encoding with an encoding time of "
+            << (((float)et2 - (float)et1) / CLOCKS_PER_SEC) << " seconds.\n";
+        for (size_t t = 0; t < feds.size(); t++) {
+            std::string path = fedPath(outDir, feds[t]);
+            out << "\nFED " << feds[t] << "\n" << logs[t];
+            if (options.outputs & OUT_GRAPHS)
+                encoder.graph(feds[t], path, options.plots);
+            if (verify(encoder, feds[t], path, options, out) != 1)
+                status = 0;
+            out << '\n';
+        }
+        out << output;
+    } else {
+        et1 = clock();
+        out << "\n\nEncoding binary files...\n\n";
+        // files are written while the histogram is drawn
+        ImageWriter writer;
+        encoder.encode(encoder.haFEDID, outDir, out, incremental, &writer);
+        et2 = clock();
+        out << "\nDone encoding with an encoding time of "
+            << (((float)et2 - (float)et1) / CLOCKS_PER_SEC)
+            << " seconds.\n";
+        if (options.outputs & OUT_GRAPHS) {
+            out << "\nGenerating histogram from source data.\n";
+            encoder.graph(encoder.haFEDID, outDir, options.plots);
+            out << "\nDone generating histogram from source data.\n";
+        }
+
+        // print to terminal
+        out << output;
+
+        // checks read the files, so the writes must be done
+        if (writer.wait(out) != 0)
+            status = 0;
+        else
+            status = verify(encoder, encoder.haFEDID, outDir, options, out);
+    }
+    return status;
+}
+
+// runs every input of a manifest in one process
+// manifest lines: input file and output directory, # starts a comment
+// inputs run on up to jobs threads while their estimated memory
+// fits in memory bytes, 0 for no limit
+// returns 1 if every input was read and its files match it
+static int runManifest(const Options& options, std::string manifest, int jobs, size_t memory) {
+    std::ifstream list(manifest.c_str());
+    if (!list.is_open()) {
+        std::cout << "Couln't read " << manifest << "\n";
+        return 0;
+    }
+    std::vector<std::pair<std::string, std::string>> runs;
+    std::string line;
+    while (std::getline(list, line)) {
+        std::stringstream fields(line.substr(0, line.find('#')));
+        std::string input, outDir;
+        if (!(fields >> input))
+            continue;
+        if (!(fields >> outDir)) {
+            std::cout << "Error: No output directory for " << input << " in " << manifest << "\n";
+            return 0;
+        }
+        if (outDir.back() != '/')
+            outDir += '/';
+        runs.emplace_back(input, outDir);
+    }
+
+    // each job opens its own TFiles
+    if (jobs > 1)
+        ROOT::EnableThreadSafety();
+    Budget budget(memory);
+    std::mutex printing;
+    std::atomic<int> skipped(0), failed(0);
+    runTasks(runs.size(), jobs, [&](size_t r) {
+        const std::string& input = runs[r].first;
+        const std::string& outDir = runs[r].second;
+        std::string status = "done";
+        if (upToDate(options, input, outDir)) {
+            status = "up to date, skipped";
+            skipped++;
+        } else {
+            // the hit store and the images
+            const Format& format = *options.format;
+            Long64_t entries = Reader(input).entries();
+            size_t estimate = (size_t)std::max(entries, (Long64_t)0) * sizeof(Hit) +
+                              format.files * (format.hitBytes() + format.pixBytes);
+            budget.acquire(estimate);
+            std::filesystem::create_directories(outDir);
+            // a run that stops leaves no stamp, whatever it wrote
+            std::error_code error;
+            std::filesystem::remove(outDir + STAMP, error);
+            std::ofstream log((outDir + "PixelEncoder.log").c_str());
+            if (runFile(options, input, outDir, log, false) != 1) {
+                status = "failed, see " + outDir + "PixelEncoder.log";
+                failed++;
+            } else {
+                std::ofstream stamp((outDir + STAMP).c_str());
+                stamp << options.outputArgs << "\n";
+                stamp.close();
+                if (!stamp.good()) {
+                    status = "done, couldn't write " + outDir + STAMP;
+                    failed++;
+                }
+            }
+            log << "\n";
+            budget.release(estimate);
+        }
+        std::lock_guard<std::mutex> lock(printing);
+        std::cout << "[" << (r + 1) << "/" << runs.size() << "] " << input << ": " << status << "\n";
+    });
+    std::cout << "\n" << runs.size() << " inputs, " << skipped << " up to date, "
+              << failed << " failed.\n";
+    Instrument::info("manifest", manifest);
+    Instrument::stat("threads", options.threads);
+    Instrument::stat("jobs", jobs);
+    Instrument::stat("inputs", runs.size());
+    Instrument::stat("skipped_inputs", skipped);
+    Instrument::stat("failed_inputs", failed);
+    return (failed == 0) ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    // clock to record process time
+    clock_t t1, t2;
+
+    Options options;
+    std::string filename;
+    // output directory, empty for the working directory
+    std::string outDir;
+    // json run report, empty for none
+    std::string reportFile;
+    // batch mode: list of inputs and output directories
+    std::string manifest;
+    // inputs of a manifest run at once
+    int jobs = 1;
+    // memory for the inputs of a manifest in MB, 0 for no limit
+    long long memoryMB = 0;
+    // event selection, 0 events for as many as the SRAM blocks hold
+    SelectMode selectMode = SELECT_ALL;
+    long long selectEvents = 0;
+    bool eventsGiven = false;
+    unsigned long long seed = 0;
+    std::string eventList;
+    bool badArgs = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        // every option but these and the input changes the outputs
+        bool output = (arg != "--threads") && (arg != "--output") && (arg != "--report") &&
+                      (arg != "--manifest") && (arg != "--jobs") && (arg != "--memory");
+        if (output && (arg.compare(0, 2, "--") == 0)) {
+            options.outputArgs += (options.outputArgs.empty() ? "" : " ") + arg;
+            if ((arg != "--two-pass") && (arg != "--all-feds") && (arg != "--stats-only") &&
+                (arg != "--no-pixels") && (arg != "--no-histograms") && (arg != "--analytics") &&
+                (arg != "--cache") &&
+                (i + 1 < argc))
+                options.outputArgs += std::string(" ") + argv[i + 1];
+        }
+        if ((arg == "--threads") && (i + 1 < argc))
+            options.threads = std::atoi(argv[++i]);
+        else if (arg == "--two-pass")
+            options.twoPass = true;
+        else if (arg == "--all-feds")
+            options.allFEDs = true;
+        else if ((arg == "--feds") && (i + 1 < argc)) {
+            std::stringstream list(argv[++i]);
+            std::string id;
+            while (std::getline(list, id, ','))
+                options.fedList.push_back(std::atoi(id.c_str()));
+        } else if ((arg == "--output") && (i + 1 < argc)) {
+            outDir = argv[++i];
+            if (outDir.back() != '/')
+                outDir += '/';
+        }
+        else if (arg == "--stats-only")
+            options.outputs = OUT_STATS;
+        else if (arg == "--no-pixels")
+            options.outputs &= ~OUT_PIXELS;
+        else if (arg == "--no-histograms")
+            options.outputs &= ~OUT_GRAPHS;
+        else if ((arg == "--plots") && (i + 1 < argc)) {
+            options.plots = plotFormats(argv[++i]);
+            if (options.plots == 0)
+                badArgs = true;
+        }
+        else if ((arg == "--format") && (i + 1 < argc)) {
+            options.format = findFormat(argv[++i]);
+            if (options.format == nullptr)
+                badArgs = true;
+        }
+        else if (arg == "--analytics")
+            options.analytics = true;
+        else if ((arg == "--target") && (i + 1 < argc)) {
+            if (parseTarget(argv[++i], options.target) != 1)
+                badArgs = true;
+        }
+        else if ((arg == "--select") && (i + 1 < argc)) {
+            if (parseSelectMode(argv[++i], selectMode) != 1)
+                badArgs = true;
+        }
+        else if ((arg == "--events") && (i + 1 < argc)) {
+            selectEvents = std::atoll(argv[++i]);
+            eventsGiven = true;
+        }
+        else if ((arg == "--seed") && (i + 1 < argc))
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        else if ((arg == "--event-list") && (i + 1 < argc))
+            eventList = argv[++i];
+        else if (arg == "--cache")
+            options.useCache = true;
+        else if ((arg == "--append") && (i + 1 < argc))
+            options.appendFiles.push_back(argv[++i]);
+        else if ((arg == "--report") && (i + 1 < argc))
+            reportFile = argv[++i];
+        else if ((arg == "--manifest") && (i + 1 < argc))
+            manifest = argv[++i];
+        else if ((arg == "--jobs") && (i + 1 < argc))
+            jobs = std::atoi(argv[++i]);
+        else if ((arg == "--memory") && (i + 1 < argc))
+            memoryMB = std::atoll(argv[++i]);
+        else if (filename.empty())
+            filename = arg;
+        else
+            badArgs = true;
+    }
+    bool multiFED = options.allFEDs || !options.fedList.empty();
+    bool incremental = !options.appendFiles.empty();
+    bool batch = !manifest.empty();
+    // events past the registers of a 32-bit block never reach the hit files
+    if ((selectMode != SELECT_ALL) && (selectEvents == 0) && (options.format != nullptr))
+        selectEvents = options.format->blockBytes / 4;
+    options.selection = EventSelection(selectMode, selectEvents, seed);
+    if (!eventList.empty() && (options.selection.readList(eventList) != 1)) {
+        std::cout << "Couln't read event ids from " << eventList << "\n";
+        badArgs = true;
+    }
+    bool selecting = !options.selection.all();
+    // options that can't be used together, each rule prints why
+    auto reject = [&](bool broken, const char* why) {
+        if (broken) {
+            std::cout << "Error: " << why << "\n";
+            badArgs = true;
+        }
+    };
+    reject((options.threads < 1) || (jobs < 1), "--threads and --jobs need at least 1");
+    reject(memoryMB < 0, "--memory can't be negative");
+    // two pass runs only store the target fed
+    reject(multiFED && options.twoPass, "--two-pass can't be used with --all-feds or --feds");
+    reject(options.twoPass && (options.analytics || (options.target.policy != TARGET_AVERAGE)),
+           "--analytics and --target need every fed, they can't be used with --two-pass");
+    reject(incremental && options.twoPass, "--append can't be used with --two-pass");
+    // a manifest replaces the input and output directory
+    reject(incremental && batch, "--append can't be used with --manifest");
+    reject(batch && !outDir.empty(), "--output can't be used with --manifest");
+    reject(selectEvents < 0, "--events can't be negative");
+    reject(eventsGiven && (selectMode == SELECT_ALL), "--events needs --select");
+    reject(!eventList.empty() && (selectMode != SELECT_ALL), "--event-list can't be used with --select");
+    reject(selecting && (options.useCache || incremental),
+           "--select and --event-list can't be used with --cache or --append");
+    if ((filename.empty() != batch) || badArgs) {  // if no arguments
+        std::cout << "usage: " << argv[0] << " <filename> [--threads N] [--output DIR]\n"
+                  << "       [--two-pass | --all-feds | --feds ID,ID,...] [--cache]\n"
+                  << "       [--append FILE ...] [--report FILE] [--stats-only | --no-pixels]\n"
+                  << "       [--no-histograms] [--plots pdf,csv,png] [--format NAME] [--analytics]\n"
+                  << "       [--target average|peak|p99|layer:N]\n"
+                  << "       [--select first|random|stratified [--events N] [--seed N] | --event-list FILE]\n"
+                  << "   or: " << argv[0] << " --manifest FILE [--jobs N] [--memory MB] [options]\n"
+                  << "SRAM formats:";
+        for (auto const& format : formats())
+            std::cout << ' ' << format.name;
+        std::cout << '\n';
+        return 1;
+    }
+
+    t1 = clock();
+    std::cout << "Program start.\n";
+
+    int status;
+    if (batch)
+        status = runManifest(options, manifest, jobs, (size_t)memoryMB << 20);
+    else
+        status = runFile(options, filename, outDir, std::cout, true);
 
     t2 = clock();
     float seconds = ((float)t2 - (float)t1) / CLOCKS_PER_SEC;
     std::cout << "\n\nProgram finish with a runtime of " << seconds
               << " seconds.\n\n";
 
-    return 1;
-}
\ No newline at end of file
+    if (!reportFile.empty()) {
+        std::ofstream report(reportFile.c_str());
+        Instrument::writeJSON(report);
+        if (!report.good())
+            std::cout << "Error: Couldn't write " << reportFile << '\n';
+    }
+
+    // non-zero if an input couldn't be read or failed verification
+    return (status == 1) ? 0 : 1;
+}
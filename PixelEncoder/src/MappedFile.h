@@ -0,0 +1,59 @@
+// Mapped File
+// Read only memory map of a whole file.
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "Includes.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile {
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+ public:
+  MappedFile() { }
+  // maps filename, check isOpen()
+  MappedFile(std::string filename) { open(filename); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  virtual ~MappedFile() { close(); }
+
+  // returns 1 on success, 0 if the file is missing
+  int open(std::string filename) {
+      close();
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+          return 0;
+      struct stat info;
+      if (fstat(fd, &info) != 0) {
+          ::close(fd);
+          return 0;
+      }
+      size_ = (size_t)info.st_size;
+      void* map = (size_ > 0) ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+      ::close(fd);
+      if (map == MAP_FAILED) {
+          size_ = 0;
+          return 0;
+      }
+      madvise(map, size_, MADV_SEQUENTIAL);
+      data_ = (const uint8_t*)map;
+      return 1;
+  }
+  void close() {
+      if (data_ != nullptr)
+          munmap((void*)data_, size_);
+      data_ = nullptr;
+      size_ = 0;
+  }
+  bool isOpen() const { return data_ != nullptr; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+};
+
+#endif
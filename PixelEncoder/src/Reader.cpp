@@ -0,0 +1,418 @@
+// Pixel Reader
+// Reads the HighFedData and ZeroData TTrees into the encoder.
+
+#include "Reader.h"
+
+#include <memory>
+
+// a range of tree entries read by one thread
+struct ReadTask {
+    const char* tree;
+    bool zero;
+    Long64_t begin;
+    Long64_t end;
+    size_t offset;
+    // entries of the range read by scanned reads, sorted
+    std::vector<Long64_t> entries;
+    bool filtered = false;
+    int status = 0;
+};
+
+// entries from begin up to the next run all hold one event
+struct EventRun {
+    Long64_t begin;
+    int event;
+};
+
+// calls f(begin, end, event) for each run of a range ending at last
+template <typename F>
+static void forEachRun(const std::vector<EventRun>& runs, Long64_t last, F f) {
+    for (size_t r = 0; r < runs.size(); r++)
+        f(runs[r].begin, (r + 1 < runs.size()) ? runs[r + 1].begin : last, runs[r].event);
+}
+
+// leaf names in Column bit order
+static const char* COLUMN_NAMES[8] = {
+    "_eventID", "_fedID", "_layer", "_channel", "_ROC", "_row", "_col", "_adc"
+};
+
+int Reader::columns(int outputs) {
+    // counts, hit files and histograms need the hits per roc,
+    // the row and column find duplicate pixels
+    int mask = COL_EVENT | COL_FED | COL_LAYER | COL_CHANNEL | COL_ROC | COL_ROW | COL_COL;
+    if (outputs & OUT_PIXELS)
+        mask |= COL_ADC;
+    return mask;
+}
+
+void Reader::enableColumns(TTree* tree, int mask) {
+    tree->SetBranchStatus("*", false);
+    for (int c = 0; c < 8; c++) {
+        if (mask & (1 << c)) {
+            std::string name = std::string("*") + COLUMN_NAMES[c];
+            tree->SetBranchStatus(name.c_str(), true);
+        }
+    }
+}
+
+std::vector<Long64_t> Reader::split(TTree* tree, int parts) {
+    Long64_t entries = tree->GetEntries();
+    // start entry of every basket cluster
+    std::vector<Long64_t> clusters;
+    auto clusterIt = tree->GetClusterIterator(0);
+    Long64_t start;
+    while ((start = clusterIt()) < entries)
+        clusters.push_back(start);
+    // each boundary is the first cluster start at or after
+    // an even share of the entries
+    std::vector<Long64_t> bounds(1, 0);
+    size_t c = 0;
+    for (int part = 1; part < parts; part++) {
+        Long64_t target = entries * part / parts;
+        while ((c < clusters.size()) && (clusters[c] < target))
+            c++;
+        bounds.push_back(c < clusters.size() ? clusters[c] : entries);
+    }
+    bounds.push_back(entries);
+    return bounds;
+}
+
+int Reader::split(std::vector<Long64_t>& boundsH, std::vector<Long64_t>& boundsZ) {
+    TFile* file = new TFile(filename_.c_str());
+    if (!(file->IsOpen())) {
+        delete file;
+        return 0;
+    }
+    TTree* treeH = nullptr;
+    TTree* treeZ = nullptr;
+    file->GetObject("HighFedData", treeH);
+    file->GetObject("ZeroData", treeZ);
+    int status = 0;
+    if ((treeH != nullptr) && (treeZ != nullptr)) {
+        boundsH = split(treeH, threads_);
+        boundsZ = split(treeZ, threads_);
+        status = 1;
+    }
+    file->Close();
+    delete file;
+    return status;
+}
+
+Long64_t Reader::entries() {
+    std::vector<Long64_t> boundsH, boundsZ;
+    if (split(boundsH, boundsZ) != 1)
+        return -1;
+    return boundsH.back() + boundsZ.back();
+}
+
+int Reader::readRange(Encoder& encoder,
+                      const char* tree,
+                      bool zero,
+                      Long64_t begin,
+                      Long64_t end,
+                      size_t offset,
+                      std::vector<Long64_t>* entries) {
+    if (begin == end)
+        return 1;
+    TFile file(filename_.c_str());
+    if (!(file.IsOpen()))
+        return 0;
+    TTree* t = nullptr;
+    file.GetObject(tree, t);
+    if (t == nullptr)
+        return 0;
+    int mask = zero ? (COL_EVENT | COL_FED | COL_LAYER) : columns_;
+    enableColumns(t, mask);
+    // for scanned reads only the listed entries are loaded,
+    // baskets holding none of them are never read
+    TEntryList list("", "", t);
+    // the list is ours, file.Close() would delete it with the directory
+    list.SetDirectory(nullptr);
+    size_t expected = (size_t)(end - begin);
+    if (entries != nullptr) {
+        for (Long64_t e : *entries)
+            list.Enter(e);
+        expected = entries->size();
+        std::vector<Long64_t>().swap(*entries);
+        if (expected == 0)
+            return 1;
+    }
+    TTreeReader reader(t, (entries != nullptr) ? &list : nullptr);
+    // every value is made before SetEntriesRange(), which loads the
+    // first entry of a range and then refuses new values.
+    // columns left out of mask read as 0
+    std::unique_ptr<TTreeReaderValue<int>> values[8];
+    for (int c = 0; c < 8; c++) {
+        if (mask & (1 << c)) {
+            std::string name = std::string("Data.") + COLUMN_NAMES[c];
+            values[c].reset(new TTreeReaderValue<int>(reader, name.c_str()));
+        }
+    }
+    if ((entries == nullptr) && (reader.SetEntriesRange(begin, end) != TTreeReader::kEntryValid))
+        return 0;
+    // entries are read in batches so the time spent in ROOT
+    // and in the encoder can be measured apart
+    const size_t BATCH = 4096;
+    std::vector<std::array<int, 8>> batch(BATCH);
+    Stopwatch rootTime, addTime;
+    size_t index = offset;
+    size_t n;
+    do {
+        rootTime.start();
+        for (n = 0; (n < BATCH) && reader.Next(); n++) {
+            for (int c = 0; c < 8; c++)
+                batch[n][c] = (values[c] != nullptr) ? **values[c] : 0;
+        }
+        rootTime.stop();
+        addTime.start();
+        for (size_t i = 0; i < n; i++) {
+            const std::array<int, 8>& v = batch[i];
+            encoder.add(index++, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        }
+        addTime.stop();
+    } while (n == BATCH);
+    rootTime.add(index - offset, file.GetBytesRead());
+    addTime.add(index - offset, (index - offset) * sizeof(Hit));
+    rootTime.record("read.root");
+    addTime.record("read.add");
+    file.Close();
+    // every slot of the range must be filled
+    return (index == offset + expected) ? 1 : 0;
+}
+
+int Reader::scanRange(const char* tree,
+                      Long64_t begin,
+                      Long64_t end,
+                      std::map<int, int>* fedHits,
+                      std::vector<EventRun>& runs) {
+    if (begin == end)
+        return 1;
+    TFile file(filename_.c_str());
+    if (!(file.IsOpen()))
+        return 0;
+    ScopedTimer timer("read.scan");
+    TTree* t = nullptr;
+    file.GetObject(tree, t);
+    if (t == nullptr)
+        return 0;
+    enableColumns(t, (fedHits != nullptr) ? (COL_EVENT | COL_FED) : COL_EVENT);
+    TTreeReader reader(t);
+    TTreeReaderValue<int> event(reader, "Data._eventID");
+    std::unique_ptr<TTreeReaderValue<int>> fed;
+    if (fedHits != nullptr)
+        fed.reset(new TTreeReaderValue<int>(reader, "Data._fedID"));
+    if (reader.SetEntriesRange(begin, end) != TTreeReader::kEntryValid)
+        return 0;
+    Long64_t e = begin;
+    while (reader.Next()) {
+        if (fedHits != nullptr)
+            (*fedHits)[**fed] += 1;
+        // pixels of an event are usually stored together
+        if (runs.empty() || (runs.back().event != *event))
+            runs.push_back({e, *event});
+        e++;
+    }
+    timer.add(e - begin, file.GetBytesRead());
+    file.Close();
+    return (e == end) ? 1 : 0;
+}
+
+int Reader::read(Encoder& encoder) {
+    scannedEvents_ = 0;
+    selectedEvents_ = 0;
+    if ((selection_ != nullptr) && !selection_->all())
+        return readScanned(encoder, false);
+    ScopedTimer timer("read");
+    std::vector<Long64_t> boundsH, boundsZ;
+    if (split(boundsH, boundsZ) != 1)
+        return 0;
+
+    // hits first, then zero events, in entry order
+    size_t base = encoder.storage.size();
+    std::vector<ReadTask> tasks;
+    for (int part = 0; part < threads_; part++) {
+        ReadTask task;
+        task.tree = "HighFedData";
+        task.zero = false;
+        task.begin = boundsH[part];
+        task.end = boundsH[part + 1];
+        task.offset = base + boundsH[part];
+        tasks.push_back(task);
+    }
+    for (int part = 0; part < threads_; part++) {
+        ReadTask task;
+        task.tree = "ZeroData";
+        task.zero = true;
+        task.begin = boundsZ[part];
+        task.end = boundsZ[part + 1];
+        task.offset = base + boundsH.back() + boundsZ[part];
+        tasks.push_back(task);
+    }
+    encoder.storage.resize(base + boundsH.back() + boundsZ.back());
+    timer.add(boundsH.back() + boundsZ.back());
+    return readTasks(encoder, tasks);
+}
+
+int Reader::listRange(const char* tree,
+                      Long64_t begin,
+                      Long64_t end,
+                      const std::vector<EventRun>& runs,
+                      const std::vector<int>* selected,
+                      int target,
+                      std::vector<Long64_t>& entries) {
+    if (begin == end)
+        return 1;
+    TFile file(filename_.c_str());
+    if (!(file.IsOpen()))
+        return 0;
+    ScopedTimer timer("read.list");
+    TTree* t = nullptr;
+    file.GetObject(tree, t);
+    if (t == nullptr)
+        return 0;
+    enableColumns(t, COL_FED);
+    TTreeReader reader(t);
+    TTreeReaderValue<int> fed(reader, "Data._fedID");
+    if (reader.SetEntriesRange(begin, end) != TTreeReader::kEntryValid)
+        return 0;
+    Long64_t e = begin;
+    size_t run = 0;
+    bool wanted = true;
+    while (reader.Next()) {
+        // the event of the entry comes from the runs of pass one
+        if ((run < runs.size()) && (runs[run].begin == e)) {
+            wanted = (selected == nullptr) ||
+                     std::binary_search(selected->begin(), selected->end(), runs[run].event);
+            run++;
+        }
+        if (wanted && (*fed == target))
+            entries.push_back(e);
+        e++;
+    }
+    timer.add(e - begin, file.GetBytesRead());
+    file.Close();
+    return (e == end) ? 1 : 0;
+}
+
+int Reader::readTarget(Encoder& encoder) {
+    return readScanned(encoder, true);
+}
+
+int Reader::readScanned(Encoder& encoder, bool byFED) {
+    ScopedTimer timer("read");
+    std::vector<Long64_t> boundsH, boundsZ;
+    if (split(boundsH, boundsZ) != 1)
+        return 0;
+
+    // pass one: the event runs of both trees, and the hits
+    // per fed for byFED. every HighFedData entry counts as a hit,
+    // duplicates are only known for the target fed after pass two
+    std::vector<std::map<int, int>> fedHits(threads_);
+    std::vector<std::vector<EventRun>> runs(2 * threads_);
+    std::vector<int> status(2 * threads_, 0);
+    runTasks(2 * threads_, threads_, [&](size_t t) {
+        int part = t % threads_;
+        if (t < (size_t)threads_) {
+            status[t] = scanRange("HighFedData", boundsH[part], boundsH[part + 1],
+                                  byFED ? &fedHits[part] : nullptr, runs[t]);
+        } else {
+            status[t] = scanRange("ZeroData", boundsZ[part], boundsZ[part + 1], nullptr, runs[t]);
+        }
+    });
+    for (int s : status) {
+        if (s != 1)
+            return 0;
+    }
+    std::vector<int> events;
+    for (auto const& r : runs) {
+        for (auto const& run : r)
+            events.push_back(run.event);
+    }
+    std::sort(events.begin(), events.end());
+    events.erase(std::unique(events.begin(), events.end()), events.end());
+    scannedEvents_ = events.size();
+    int target = -1;
+    if (byFED) {
+        std::map<int, int> hitspFED;
+        for (auto const& part : fedHits) {
+            for (auto const& fid : part)
+                hitspFED[fid.first] += fid.second;
+        }
+        encoder.setCounts(hitspFED, events.size());
+        target = encoder.selectFED();
+    }
+
+    // the selection sees the hits of each event in every fed
+    bool selecting = (selection_ != nullptr) && !selection_->all();
+    std::vector<int> selected = events;
+    if (selecting) {
+        std::vector<uint64_t> hits(events.size(), 0);
+        for (int part = 0; part < threads_; part++) {
+            forEachRun(runs[part], boundsH[part + 1], [&](Long64_t begin, Long64_t end, int event) {
+                hits[std::lower_bound(events.begin(), events.end(), event) - events.begin()] += end - begin;
+            });
+        }
+        selected = selection_->select(events, hits);
+    }
+    selectedEvents_ = selected.size();
+
+    // pass two: list the entries of the selected events, of the
+    // target fed for byFED, then read them
+    std::vector<ReadTask> tasks(2 * threads_);
+    for (int z = 0; z < 2; z++) {
+        std::vector<Long64_t>& bounds = (z == 0) ? boundsH : boundsZ;
+        for (int part = 0; part < threads_; part++) {
+            ReadTask& task = tasks[z * threads_ + part];
+            task.tree = (z == 0) ? "HighFedData" : "ZeroData";
+            task.zero = (z == 1);
+            task.begin = bounds[part];
+            task.end = bounds[part + 1];
+            task.filtered = true;
+        }
+    }
+    if (byFED) {
+        runTasks(tasks.size(), threads_, [&](size_t t) {
+            ReadTask& task = tasks[t];
+            status[t] = listRange(task.tree, task.begin, task.end, runs[t],
+                                  selecting ? &selected : nullptr, target, task.entries);
+        });
+        for (int s : status) {
+            if (s != 1)
+                return 0;
+        }
+    } else {
+        for (size_t t = 0; t < tasks.size(); t++) {
+            ReadTask& task = tasks[t];
+            forEachRun(runs[t], task.end, [&](Long64_t begin, Long64_t end, int event) {
+                if (!std::binary_search(selected.begin(), selected.end(), event))
+                    return;
+                for (Long64_t e = begin; e < end; e++)
+                    task.entries.push_back(e);
+            });
+        }
+    }
+    size_t offset = encoder.storage.size();
+    for (auto& task : tasks) {
+        task.offset = offset;
+        offset += task.entries.size();
+    }
+    encoder.storage.resize(offset);
+    timer.add(boundsH.back() + boundsZ.back());
+    return readTasks(encoder, tasks);
+}
+
+int Reader::readTasks(Encoder& encoder, std::vector<ReadTask>& tasks) {
+    for (auto& task : tasks)
+        task.status = 0;
+    runTasks(tasks.size(), threads_, [&](size_t t) {
+        ReadTask& task = tasks[t];
+        task.status = readRange(encoder, task.tree, task.zero, task.begin, task.end,
+                                task.offset, task.filtered ? &task.entries : nullptr);
+    });
+    int status = 1;
+    for (auto const& task : tasks) {
+        if (task.status != 1)
+            status = 0;
+    }
+    return status;
+}
@@ -0,0 +1,130 @@
+// Pixel Reader
+// Reads the HighFedData and ZeroData TTrees into the encoder.
+// Trees are split on basket cluster boundaries and each
+// range is read by its own thread with its own TFile.
+// Every entry has a fixed slot in the hit store, so the
+// stored order and duplicate count match a serial read.
+//
+// readTarget() reads in two passes: the first only reads
+// _fedID and _eventID to count the hits per fed and pick the
+// highest average fed, the second lists the entries of that
+// fed from _fedID alone and reads their pixels through entry
+// lists. No array over every entry of the input is kept.
+// With an event selection read() also scans _eventID first
+// and then reads only the entries of the selected events.
+//
+// Only the columns used by the outputs of the run are read,
+// the other branches are disabled so their baskets are never
+// loaded or decompressed. _row and _col are always read since
+// duplicate pixels are found by their address.
+
+#ifndef READER_H
+#define READER_H
+
+#include "Includes.h"
+#include "Encoder.h"
+#include "EventSelection.h"
+#include "Instrument.h"
+#include "Tasks.h"
+
+struct ReadTask;
+struct EventRun;
+
+// leaves of the Data branch, bits of Reader::columns()
+enum Column {
+    COL_EVENT = 1,
+    COL_FED = 2,
+    COL_LAYER = 4,
+    COL_CHANNEL = 8,
+    COL_ROC = 16,
+    COL_ROW = 32,
+    COL_COL = 64,
+    COL_ADC = 128
+};
+
+class Reader {
+ private:
+  std::string filename_;
+  int threads_;
+  // Column flags read from HighFedData
+  int columns_;
+  // events read, nullptr for every event
+  const EventSelection* selection_ = nullptr;
+  // events in the input and events read by the last read
+  size_t scannedEvents_ = 0;
+  size_t selectedEvents_ = 0;
+  // enables only the columns in mask on a tree
+  static void enableColumns(TTree* tree, int mask);
+  // splits entries of a tree into parts on cluster boundaries
+  // returns parts + 1 boundaries
+  std::vector<Long64_t> split(TTree* tree, int parts);
+  // splits both trees into one range per thread
+  int split(std::vector<Long64_t>& boundsH, std::vector<Long64_t>& boundsZ);
+  // reads entries [begin, end) of a tree into the store at offset.
+  // if entries is set only those entries of the range are read,
+  // the list is freed once it is handed to ROOT
+  // returns 1 on success
+  int readRange(Encoder& encoder,
+                const char* tree,
+                bool zero,
+                Long64_t begin,
+                Long64_t end,
+                size_t offset,
+                std::vector<Long64_t>* entries);
+  // reads the event of each run of entries [begin, end) with
+  // the same event, and counts the entries of each fed if fedHits is set
+  int scanRange(const char* tree,
+                Long64_t begin,
+                Long64_t end,
+                std::map<int, int>* fedHits,
+                std::vector<EventRun>& runs);
+  // lists the entries of fed target in [begin, end) reading only _fedID,
+  // of the selected events if selected is set
+  // runs: event runs of the range from scanRange()
+  int listRange(const char* tree,
+                Long64_t begin,
+                Long64_t end,
+                const std::vector<EventRun>& runs,
+                const std::vector<int>* selected,
+                int target,
+                std::vector<Long64_t>& entries);
+  // scans the trees, then reads the entries of the selected events,
+  // only of the highest average fed if byFED is set
+  int readScanned(Encoder& encoder, bool byFED);
+  // runs read tasks on the reader threads
+  int readTasks(Encoder& encoder, std::vector<ReadTask>& tasks);
+ public:
+  // outputs: Output flags of the run, decide the columns read
+  Reader(std::string filename, int threads = 1, int outputs = OUT_ALL)
+      : filename_(filename), threads_(threads < 1 ? 1 : threads), columns_(columns(outputs)) {
+      // each thread opens its own TFile
+      if (threads_ > 1)
+          ROOT::EnableThreadSafety();
+  }
+  virtual ~Reader() { }
+
+  // Column flags of HighFedData needed for Output flags outputs,
+  // ZeroData only has _eventID, _fedID and _layer
+  static int columns(int outputs);
+
+  // entries in both trees, -1 if the file or trees could not be read
+  Long64_t entries();
+  // reads only the events picked by selection, which must
+  // outlive the reads. nullptr reads every event
+  void setSelection(const EventSelection* selection) { selection_ = selection; }
+  // events in the input and events read by the last scanned read,
+  // a selection or readTarget(), zero otherwise
+  size_t scannedEvents() const { return scannedEvents_; }
+  size_t selectedEvents() const { return selectedEvents_; }
+
+  // reads both trees into the encoder, only the selected events
+  // with a selection. hit and event counts are of the events read
+  // returns 1 on success, 0 if the file or trees could not be read
+  int read(Encoder& encoder);
+  // reads only the pixels of the highest average fed, and with
+  // a selection only of the selected events. hit and event counts
+  // of every fed and event come from a first pass
+  int readTarget(Encoder& encoder);
+};
+
+#endif
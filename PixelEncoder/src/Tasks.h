@@ -0,0 +1,63 @@
+// Task Runner
+// Runs numbered tasks on a fixed number of threads.
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "Includes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// runs f(task) for tasks 0 to count - 1 on up to threads threads
+// tasks are started in order, each by the next free thread
+template <typename F>
+void runTasks(size_t count, int threads, F f) {
+    if ((threads <= 1) || (count <= 1)) {
+        for (size_t t = 0; t < count; t++)
+            f(t);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int n = 0; (n < threads) && ((size_t)n < count); n++) {
+        workers.emplace_back([&]() {
+            for (size_t t = next++; t < count; t = next++)
+                f(t);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+// shares a total amount, such as memory, among running tasks
+class Budget {
+ private:
+  std::mutex mutex_;
+  std::condition_variable released_;
+  // 0 for no limit
+  size_t total_;
+  size_t used_ = 0;
+ public:
+  Budget(size_t total = 0) : total_(total) { }
+
+  // waits until amount fits in what is left of the total,
+  // an amount larger than the total waits until nothing is used
+  void acquire(size_t amount) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      released_.wait(lock, [&]() {
+          return (total_ == 0) || (used_ == 0) || (used_ + amount <= total_);
+      });
+      used_ += amount;
+  }
+  void release(size_t amount) {
+      {
+          std::lock_guard<std::mutex> lock(mutex_);
+          used_ -= amount;
+      }
+      released_.notify_all();
+  }
+};
+
+#endif
@@ -0,0 +1,255 @@
+// Round Trip Verifier
+// Compares SRAM files of a fed with the encoder's hit store.
+
+#include "Verifier.h"
+#include "MappedFile.h"
+#include "Tasks.h"
+
+// collects mismatches of one file pair
+struct Report {
+    std::ostringstream text;
+    int count = 0;
+    int limit;
+    void add(const std::string& file, size_t offset, const std::string& what) {
+        if (count < limit)
+            text << file << " offset 0x" << std::hex << offset << std::dec << ": " << what << '\n';
+        count++;
+    }
+};
+
+// pixel word as text, 0x........ (row r col c adc a)
+static std::string pixText(uint32_t line) {
+    int row, col, adc;
+    Decoder::decodePix(line, row, col, adc);
+    std::ostringstream text;
+    text << "0x" << std::hex << std::setw(8) << std::setfill('0') << line << std::dec
+         << " (row " << row << " col " << col << " adc " << adc << ")";
+    return text.str();
+}
+
+// checks that data repeats with period bytes after the first period
+// a period of 0 means the source was empty and data must be zero
+static void checkRepeat(Report& report, const std::string& file, size_t base,
+                        const uint8_t* data, size_t size, size_t period) {
+    const size_t CHUNK = 65536;
+    if (period == 0) {
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != 0) {
+                report.add(file, base + i, "expected zero fill");
+                return;
+            }
+        }
+        return;
+    }
+    for (size_t j = period; j < size; j += CHUNK) {
+        size_t n = std::min(CHUNK, size - j);
+        if (std::memcmp(data + j, data + j - period, n) == 0)
+            continue;
+        for (size_t i = 0; i < n; i++) {
+            if (data[j + i] != data[j + i - period]) {
+                std::ostringstream what;
+                what << "repeat differs from offset 0x" << std::hex << (base + j + i - period);
+                report.add(file, base + j + i, what.str());
+                break;
+            }
+        }
+    }
+}
+
+int Verifier::verifyPair(int filenum, const Decoder* decoder, std::ostream& out) const {
+    ScopedTimer timer("verify");
+    const Format& format = encoder_.format();
+    const size_t HITSIZE = format.hitBytes();
+    const size_t PIXSIZE = format.pixBytes;
+    const int CHANNELS = format.channels;
+    std::string hitName = "SRAMhit" + std::to_string(filenum) + ".bin";
+    std::string pixName = "SRAMpix" + std::to_string(filenum) + ".bin";
+    // pixel files are only written with the adc column
+    bool checkPixels = (encoder_.outputs() & OUT_PIXELS) != 0;
+    MappedFile hitFile(path_ + hitName);
+    MappedFile pixFile;
+    if (checkPixels)
+        pixFile.open(path_ + pixName);
+    if (!hitFile.isOpen() || (hitFile.size() != HITSIZE)) {
+        out << "Error: Missing or wrong size " << hitName << " in directory.\n";
+        return -1;
+    }
+    if (checkPixels && (!pixFile.isOpen() || (pixFile.size() != PIXSIZE))) {
+        out << "Error: Missing or wrong size " << pixName << " in directory.\n";
+        return -1;
+    }
+    const uint8_t* hits = hitFile.data();
+    const uint8_t* pixels = pixFile.data();
+    if (checkPixels)
+        timer.add(2, HITSIZE + PIXSIZE);
+    else
+        timer.add(1, HITSIZE);
+
+    Report report;
+    report.limit = reportLimit_;
+    uint32_t types[48];
+    encoder_.blockTypes(encoder_.fedStats(fed_), types);
+    size_t blockBytes = format.blockBytes;
+    // register width of each block from its format
+    std::vector<size_t> width(CHANNELS);
+    std::vector<size_t> registers(CHANNELS);
+    size_t maxRegisters = 0;
+    for (int block = 0; block < CHANNELS; block++) {
+        width[block] = (types[block + (filenum * CHANNELS)] == 3) ? 8 : 4;
+        registers[block] = blockBytes / width[block];
+        maxRegisters = std::max(maxRegisters, registers[block]);
+    }
+    size_t pixWords = PIXSIZE / 4;
+
+    uint32_t header, expected = 0;
+    std::memcpy(&header, hits, 4);
+    for (int block = 0; block < CHANNELS; block++)
+        expected = (expected << 2 | types[block + (filenum * CHANNELS)]);
+    if (header != expected) {
+        std::ostringstream what;
+        what << "header expected 0x" << std::hex << expected << " found 0x" << header;
+        report.add(hitName, 0, what.str());
+    }
+
+    // hits in each register written, as the decoder sums them
+    std::vector<std::vector<uint32_t>> sums(CHANNELS);
+
+    // walk the events of the fed in encoding order
+    // k: register of each block, pix: word in the pixel file
+    size_t k = 0;
+    size_t pix = 0;
+    bool done = false;
+    auto fed = encoder_.storage.fed(fed_);
+    forEachEvent(fed.first, fed.second, [&](int event, bool zero, const Hit* first, const Hit* last) {
+        if (done)
+            return;
+        const Hit* p = first;
+        for (int block = 0; block < CHANNELS; block++) {
+            int ch = block + (filenum * CHANNELS) + 1;
+            while ((p != last) && (p->ch < ch))
+                p++;
+            const Hit* chEnd = p;
+            while ((chEnd != last) && (chEnd->ch == ch))
+                chEnd++;
+            bool empty = zero || (p == chEnd);
+            if (k < registers[block]) {
+                uint64_t counts[9] = {0};
+                if (!empty) {
+                    for (const Hit* h = p; h != chEnd; h++) {
+                        if (h->roc < 9)
+                            counts[h->roc]++;
+                    }
+                }
+                size_t offset = Format::HEADERBYTES + block * blockBytes + k * width[block];
+                uint64_t line = 0;
+                std::memcpy(&line, hits + offset, width[block]);
+                int rocs = (types[ch - 1] == 0) ? 2 : ((types[ch - 1] == 1) ? 4 : 8);
+                int bits = (types[ch - 1] == 2) ? 4 : ((types[ch - 1] == 0) ? 16 : 8);
+                // roc 1 is the most significant field, counts
+                // are cut to the field width as the encoder does
+                const uint64_t mask = (1ull << bits) - 1;
+                uint64_t sum = 0;
+                for (int r = 1; r <= rocs; r++) {
+                    sum += counts[r] & mask;
+                    uint64_t found = (line >> ((rocs - r) * bits)) & mask;
+                    if (found != (counts[r] & mask)) {
+                        std::ostringstream what;
+                        what << "event " << event << " channel " << ch << " roc " << r
+                             << " expected " << (counts[r] & mask) << " hits found " << found;
+                        report.add(hitName, offset, what.str());
+                    }
+                }
+                if (decoder != nullptr)
+                    sums[block].push_back(sum);
+            }
+            // pixels are still counted without pixel files,
+            // the hit files end where the pixel file filled
+            if (!empty && !checkPixels) {
+                pix = std::min(pixWords, pix + (chEnd - p));
+            } else if (!empty) {
+                for (const Hit* h = p; (h != chEnd) && (pix < pixWords); h++, pix++) {
+                    uint32_t want = ((uint32_t)h->row << 16 | (uint32_t)h->col << 8 | (uint32_t)h->adc);
+                    uint32_t found;
+                    std::memcpy(&found, pixels + pix * 4, 4);
+                    if (found != want) {
+                        std::ostringstream what;
+                        what << "event " << event << " channel " << ch << " roc " << (int)h->roc
+                             << " expected " << pixText(want) << " found " << pixText(found);
+                        report.add(pixName, pix * 4, what.str());
+                    }
+                }
+            }
+            p = chEnd;
+        }
+        k++;
+        if ((k >= maxRegisters) && (pix >= pixWords))
+            done = true;
+    });
+
+    // past the source data both files repeat from the start
+    for (int block = 0; block < CHANNELS; block++) {
+        if (k < registers[block]) {
+            size_t base = Format::HEADERBYTES + block * blockBytes;
+            checkRepeat(report, hitName, base, hits + base, blockBytes, k * width[block]);
+        }
+    }
+    if (checkPixels && (pix < pixWords))
+        checkRepeat(report, pixName, 0, pixels, PIXSIZE, pix * 4);
+
+    // the written registers repeat to the end of each block,
+    // so each channel has registers[block] / k copies of them
+    // and the first registers[block] % k once more
+    for (int block = 0; (decoder != nullptr) && (block < CHANNELS); block++) {
+        int ch = block + (filenum * CHANNELS) + 1;
+        const std::vector<uint32_t>& written = sums[block];
+        std::vector<uint64_t> expected(1, 0);
+        if (written.empty()) {
+            expected[0] = registers[block];
+        } else {
+            for (size_t j = 0; j < registers[block]; j++) {
+                uint32_t hits = written[j % written.size()];
+                if (hits >= expected.size())
+                    expected.resize(hits + 1, 0);
+                expected[hits]++;
+            }
+        }
+        const std::vector<uint64_t>& decoded = decoder->hits(ch);
+        for (size_t hits = 0; hits < std::max(expected.size(), decoded.size()); hits++) {
+            uint64_t want = (hits < expected.size()) ? expected[hits] : 0;
+            uint64_t found = (hits < decoded.size()) ? decoded[hits] : 0;
+            if (want != found) {
+                std::ostringstream what;
+                what << "channel " << ch << " expected " << want << " registers with "
+                     << hits << " hits, decoded " << found;
+                report.add(hitName, Format::HEADERBYTES + block * blockBytes, what.str());
+                break;
+            }
+        }
+    }
+
+    out << report.text.str();
+    if (report.count > report.limit)
+        out << "... " << (report.count - report.limit) << " more mismatches in "
+            << hitName << " and " << pixName << '\n';
+    return report.count;
+}
+
+int Verifier::verify(std::ostream& out, const Decoder* decoder) const {
+    int files = encoder_.format().files;
+    std::vector<std::string> text(files);
+    std::vector<int> results(files);
+    runTasks(files, files, [&](size_t filenum) {
+        std::ostringstream log;
+        results[filenum] = verifyPair(filenum, decoder, log);
+        text[filenum] = log.str();
+    });
+    int mismatches = 0;
+    for (int filenum = 0; filenum < files; filenum++) {
+        out << text[filenum];
+        if (results[filenum] < 0)
+            mismatches = -1;
+        else if (mismatches >= 0)
+            mismatches += results[filenum];
+    }
+    return mismatches;
+}
@@ -0,0 +1,40 @@
+// Round Trip Verifier
+// Decodes the SRAMhit and SRAMpix files of a fed and compares
+// the hits per roc and the pixel addresses of every event and
+// channel with the encoder's hit store. Mismatches are reported
+// with their file offsets. The file pairs of the encoder's
+// format are checked in parallel. Runs without OUT_PIXELS only check the hit files.
+//
+// Given a decoder, the registers per hit count of each channel
+// it decoded, the data of the binary histogram, are compared
+// with the counts expected from the source hits.
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "Includes.h"
+#include "Encoder.h"
+#include "Decoder.h"
+
+class Verifier {
+ private:
+  const Encoder& encoder_;
+  int fed_;
+  std::string path_;
+  // mismatches printed per file pair, the rest are only counted
+  int reportLimit_;
+  // checks SRAMhit# and SRAMpix#, returns mismatches or -1
+  int verifyPair(int filenum, const Decoder* decoder, std::ostream& out) const;
+ public:
+  // fed: fed the files in path were encoded from
+  Verifier(const Encoder& encoder, int fed, std::string path = "", int reportLimit = 20)
+      : encoder_(encoder), fed_(fed), path_(path), reportLimit_(reportLimit) { }
+  virtual ~Verifier() { }
+
+  // checks all three file pairs, and the channel hit counts
+  // of decoder if set, decoded from the same files
+  // returns the number of mismatches, -1 if a file is missing or the wrong size
+  int verify(std::ostream& out = std::cout, const Decoder* decoder = nullptr) const;
+};
+
+#endif